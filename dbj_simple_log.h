@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdarg.h>
+#include <stdbool.h> // dbj_log_pool_reserve
 
 // default is coloured output
 #ifndef DBJ_LOG_USE_COLOR
@@ -243,6 +244,24 @@ __inline FILE* dbj_fhandle_file_ptr(dbj_fhandle* self /* const char* options_ */
 		DBJ_LOG_NO_CONSOLE = 8,
 		/* default is time  only */
 		DBJ_LOG_FULL_TIMESTAMP = 16,
+		/* many processes, one log file, through the shared memory ring */
+		DBJ_LOG_SHARED_RING = 32,
+		/* sparse side index of the log file, for dbj_log_query tool */
+		DBJ_LOG_FILE_INDEX = 64,
+		/* nothing is done before the first log line passing the level filter */
+		DBJ_LOG_LAZY = 128,
+		/* nanosecond stamps from the TSC, strictly ordered */
+		DBJ_LOG_TSC_TIMESTAMP = 256,
+		/* LZ4 compressed frames, log file name ends with .lz4, see dbj_log_cat */
+		DBJ_LOG_COMPRESS = 512,
+		/* console written by its own thread, lines are dropped if it is too slow */
+		DBJ_LOG_CONSOLE_ASYNC = 1024,
+		/* logging cost per call site, reported at the end, see dbj_log_profile_report */
+		DBJ_LOG_PROFILE = 2048,
+		/* file lines are also shipped to the collector, DBJ_LOG_NET_HOST : DBJ_LOG_NET_PORT */
+		DBJ_LOG_NET = 4096,
+		/* log file records have the length and CRC32C, see dbj_log_recover */
+		DBJ_LOG_CRC = 8192,
 	} DBJ_LOG_SETUP;
 
 	/////////////////////////////////////////////////////////////////////////////////////
@@ -251,8 +270,197 @@ __inline FILE* dbj_fhandle_file_ptr(dbj_fhandle* self /* const char* options_ */
 	/// this is used inside the constructor
 	/// by default we log to console and to file and 
 	/// we lock each log call
-#undef  DBJ_LOG_DEFAULT_SETUP
+	/// define yours before including this header
+	/// log function is specialized for it, unless DBJ_LOG_RUNTIME_SETUP is defined
+#ifndef DBJ_LOG_DEFAULT_SETUP
 #define DBJ_LOG_DEFAULT_SETUP ( DBJ_LOG_TO_FILE | DBJ_LOG_MT )
+#endif
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// log records are taken from the pool of size classed slabs
+	/// this is how many records per size class are made, on the first use
+	/// dbj_log_pool_reserve makes more, at runtime
+	/// when the pool is exhausted records are taken from the heap
+	/// and that is counted, see dbj_log_pool_stats
+#ifndef DBJ_LOG_POOL_RECORDS
+#define DBJ_LOG_POOL_RECORDS 16
+#endif
+
+#define DBJ_LOG_POOL_CLASSES 4
+
+	/// DBJ_LOG_CONSOLE_ASYNC, bytes waiting for the console, at most
+#ifndef DBJ_LOG_CONSOLE_BUFFER
+#define DBJ_LOG_CONSOLE_BUFFER (256 * 1024)
+#endif
+
+	/// DBJ_LOG_TSC_TIMESTAMP, wall time and the TSC are compared that often
+#ifndef DBJ_LOG_CLOCK_CALIBRATE_MS
+#define DBJ_LOG_CLOCK_CALIBRATE_MS 60000
+#endif
+
+	/// DBJ_LOG_NET needs DBJ_LOG_NET_ENABLED defined before the implementation is included
+	/// only then winsock is included and ws2_32.lib linked
+	/// DBJ_LOG_NET, where is the collector, see also dbj_log_net_endpoint
+#ifndef DBJ_LOG_NET_HOST
+#define DBJ_LOG_NET_HOST "127.0.0.1"
+#endif
+#ifndef DBJ_LOG_NET_PORT
+#define DBJ_LOG_NET_PORT "5170"
+#endif
+	/// 1 is UDP, one frame per datagram, 0 is TCP
+#ifndef DBJ_LOG_NET_UDP
+#define DBJ_LOG_NET_UDP 0
+#endif
+	/// 0 is no LZ4, frames are raw
+#ifndef DBJ_LOG_NET_COMPRESS
+#define DBJ_LOG_NET_COMPRESS 1
+#endif
+	/// bytes waiting to be shipped, at most, the rest is dropped
+#ifndef DBJ_LOG_NET_BUFFER
+#define DBJ_LOG_NET_BUFFER (1024 * 1024)
+#endif
+	/// frame is at most this many bytes of text, made when there is that much
+	/// or after DBJ_LOG_NET_FLUSH_MS
+#ifndef DBJ_LOG_NET_BATCH
+#define DBJ_LOG_NET_BATCH (32 * 1024)
+#endif
+#ifndef DBJ_LOG_NET_FLUSH_MS
+#define DBJ_LOG_NET_FLUSH_MS 200
+#endif
+	/// collector that is not there is not tried again before this
+#ifndef DBJ_LOG_NET_RETRY_MS
+#define DBJ_LOG_NET_RETRY_MS 2000
+#endif
+
+	/// log file is preallocated to this size, on the thread pool
+	/// 0 is no preallocation
+#ifndef DBJ_LOG_PREALLOCATE
+#define DBJ_LOG_PREALLOCATE 0
+#endif
+
+	typedef struct dbj_log_pool_stats {
+		/* per size class */
+		size_t record_size[DBJ_LOG_POOL_CLASSES];
+		size_t capacity[DBJ_LOG_POOL_CLASSES];
+		long long allocations[DBJ_LOG_POOL_CLASSES];
+		long long cross_thread_frees[DBJ_LOG_POOL_CLASSES];
+		long long in_use[DBJ_LOG_POOL_CLASSES];
+		/* class exhausted or record too big, heap was used */
+		long long heap_allocations;
+		long long heap_in_use;
+	} dbj_log_pool_stats;
+
+	/* snapshot of the record pool counters, any time from any thread */
+	void dbj_log_pool_get_stats(dbj_log_pool_stats* /*stats*/);
+
+	/* at least that many records per size class, from now on
+	   for the apps with many logging threads, see heap_allocations
+	   any time from any thread, false if some slab could not be made */
+	bool dbj_log_pool_reserve(int /*records_per_class*/);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// DBJ_LOG_SHARED_RING collector
+	/// 
+	/// drains the ring of the app given into the app log file
+	/// this is what dbj_log_collector tool does, returns when stopped
+	/// an app in the DBJ_LOG_SHARED_RING mode does not need to call this
+	/// one of the workers is elected to collect, if no one else does
+	int dbj_log_ring_collector_run(const char* /*app_full_path*/);
+	void dbj_log_ring_collector_stop(void);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// DBJ_LOG_FILE_INDEX
+	/// 
+	/// side index file is named: log file name + ".idx"
+	/// it is the header followed by the entries, one per block of log lines
+	/// block is closed every DBJ_LOG_INDEX_LINES lines or DBJ_LOG_INDEX_BYTES bytes
+#ifndef DBJ_LOG_INDEX_LINES
+#define DBJ_LOG_INDEX_LINES 256
+#endif
+#ifndef DBJ_LOG_INDEX_BYTES
+#define DBJ_LOG_INDEX_BYTES (64 * 1024)
+#endif
+
+#define DBJ_LOG_INDEX_MAGIC 0x58444E49 /* "INDX" */
+
+	typedef struct dbj_log_index_header {
+		unsigned magic;
+		unsigned entry_size;
+	} dbj_log_index_header;
+
+	typedef struct dbj_log_index_entry {
+		/* of the first line in the log file */
+		unsigned long long offset;
+		/* time_t of the first and the last line */
+		long long first_time;
+		long long last_time;
+		/* 1 << level, of all the lines in the block */
+		unsigned level_bits;
+		unsigned lines;
+		unsigned long long bytes;
+	} dbj_log_index_entry;
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// DBJ_LOG_COMPRESS file layout
+	/// 
+	/// frames: dbj_log_frame_header followed by its stored_size bytes
+	/// then the seek table: dbj_log_seek_entry for each frame
+	/// then dbj_log_seek_trailer, as the last bytes of the file
+	/// no seek table if the process did not end properly, frames can be walked still
+#ifndef DBJ_LOG_COMPRESS_BLOCK
+#define DBJ_LOG_COMPRESS_BLOCK (128 * 1024)
+#endif
+#ifndef DBJ_LOG_COMPRESS_BLOCKS
+#define DBJ_LOG_COMPRESS_BLOCKS 4
+#endif
+#ifndef DBJ_LOG_COMPRESS_FLUSH_MS
+#define DBJ_LOG_COMPRESS_FLUSH_MS 1000
+#endif
+
+#define DBJ_LOG_FRAME_MAGIC 0x4D415246 /* "FRAM" */
+#define DBJ_LOG_SEEK_MAGIC 0x4B454553 /* "SEEK" */
+/* frame is stored, not compressed */
+#define DBJ_LOG_FRAME_RAW 1u
+
+	typedef struct dbj_log_frame_header {
+		unsigned magic;
+		unsigned stored_size;
+		unsigned raw_size;
+		unsigned flags;
+	} dbj_log_frame_header;
+
+	typedef struct dbj_log_seek_entry {
+		/* of the frame header, in the file */
+		unsigned long long offset;
+		/* of the frame text, in the whole log text */
+		unsigned long long raw_offset;
+	} dbj_log_seek_entry;
+
+	typedef struct dbj_log_seek_trailer {
+		/* of the seek table */
+		unsigned long long table_offset;
+		unsigned count;
+		unsigned magic;
+	} dbj_log_seek_trailer;
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// DBJ_LOG_CRC file layout
+	/// 
+	/// file is <exe>.log.crc, it never holds the text lines of the other setups
+	/// each write to the log file is one record: dbj_log_crc_header then the text
+	/// crc is CRC32C of the length, as stored, and then of the text
+	/// torn records at the end, after the crash, are found and cut off by dbj_log_recover
+#define DBJ_LOG_CRC_MAGIC 0x43524344 /* "DCRC" */
+
+	typedef struct dbj_log_crc_header {
+		unsigned magic;
+		/* of the text */
+		unsigned length;
+		unsigned crc;
+	} dbj_log_crc_header;
+
+	/* CRC32C, 0 to begin with, previous result to continue */
+	unsigned dbj_log_crc32c(unsigned /*crc*/, const void* /*data*/, size_t /*len*/);
 
 	// can be used from other parts,
 	// not just an host app
@@ -274,11 +482,141 @@ __inline FILE* dbj_fhandle_file_ptr(dbj_fhandle* self /* const char* options_ */
 		DBJ_LOG_FATAL
 	} DBJ_LOG_LEVEL;
 
+	/* lines below this level are not logged, default is DBJ_LOG_TRACE */
+	void dbj_simple_log_set_level(int /*DBJ_LOG_LEVEL*/);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// backpressure
+	/// 
+	/// when writing a line takes longer than DBJ_LOG_DEGRADE_LATENCY_US, on average,
+	/// or more than DBJ_LOG_DEGRADE_BACKLOG threads wait to log,
+	/// effective level is raised, up to WARN, and one WARN line says so
+	/// configured level is restored, after DBJ_LOG_DEGRADE_HOLD_MS of recovery
+	/// write is timed with the flush after it, on the commit mode that is the disk itself
+	/// default 0 is off, 10000 is a good start for the apps that want it
+#ifndef DBJ_LOG_DEGRADE_LATENCY_US
+#define DBJ_LOG_DEGRADE_LATENCY_US 0
+#endif
+#ifndef DBJ_LOG_DEGRADE_BACKLOG
+#define DBJ_LOG_DEGRADE_BACKLOG 8
+#endif
+#ifndef DBJ_LOG_DEGRADE_HOLD_MS
+#define DBJ_LOG_DEGRADE_HOLD_MS 2000
+#endif
+	/* configured level, or higher under backpressure */
+	int dbj_simple_log_effective_level(void);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// per thread diagnostic context
+	/// 
+	/// after the prefix, each line of the thread is tagged with
+	/// [<thread id>:<thread name> key=value ...] 
+	/// tag is made only when the context changes, not per line
+	/// nothing is tagged if the thread has no name and no context
+#ifndef DBJ_LOG_CTX_MAX
+#define DBJ_LOG_CTX_MAX 8
+#endif
+	void dbj_log_ctx_push(const char* /*key*/, const char* /*value*/);
+	void dbj_log_ctx_pop(void);
+	void dbj_log_thread_name(const char* /*name*/);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// sampling of the busy call sites
+	/// 
+	/// one in N lines is kept, N per level or per call site, 0 or 1 is all
+	/// site is file and line, file as __FILE__ gives it
+	/// under the byte/sec budget, busiest sites are sampled down even more
+	/// kept lines are tagged with {w=N}, for the counts to be reconstructed
+#ifndef DBJ_LOG_SAMPLE_SITES
+#define DBJ_LOG_SAMPLE_SITES 1024
+#endif
+	void dbj_log_sample_level(int /*DBJ_LOG_LEVEL*/, unsigned /*one_in*/);
+	void dbj_log_sample_site(const char* /*file*/, int /*line*/, unsigned /*one_in*/);
+	/* 0 is no budget */
+	void dbj_log_sample_budget(unsigned /*bytes_per_second*/);
+
 	// all eventually goes through here
 	void dbj_simple_log_log(int /*level*/, const char* /*file*/, int /*line*/, const char* /*fmt*/, ...);
 
+	/* DBJ_LOG_NET, collector is somewhere else from now on, NULL is no change */
+	void dbj_log_net_endpoint(const char* /*host*/, const char* /*port*/);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// DBJ_LOG_PROFILE, logging cost per call site
+	/// 
+	/// calls, bytes and time spent of each log call site, file and line,
+	/// are counted, and the sites that cost the most are reported
+	/// at the end, DBJ_LOG_PROFILE_TOP of them, or on demand
+#ifndef DBJ_LOG_PROFILE_SITES
+#define DBJ_LOG_PROFILE_SITES 1024
+#endif
+#ifndef DBJ_LOG_PROFILE_TOP
+#define DBJ_LOG_PROFILE_TOP 20
+#endif
+	/* top 0 is all of them */
+	void dbj_log_profile_report(unsigned /*top*/);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// batch of lines
+	/// 
+	/// lines between begin and end are kept by the thread, then logged together:
+	/// one time stamp, one lock, one write per target, no other lines in between
+	/// batch of more than DBJ_LOG_BATCH_LINES is logged in parts
+	/// begin inside the open batch joins it, its lines are logged with the outer ones
+#ifndef DBJ_LOG_BATCH_LINES
+#define DBJ_LOG_BATCH_LINES 256
+#endif
+	void dbj_simple_log_batch_begin(int /*level*/, const char* /*file*/, int /*line*/);
+	void dbj_simple_log_batch_line(const char* /*file*/, int /*line*/, const char* /*fmt*/, ...);
+	void dbj_simple_log_batch_end(void);
+
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// binary data dump
+	/// 
+	/// label and the classic offset, hex and ASCII lines, or one base64 field
+	/// each row is the log line of its own, prefixed, logged as one batch
+	/// not more than DBJ_LOG_DUMP_MAX bytes are dumped, 0 is no limit
+#ifndef DBJ_LOG_DUMP_MAX
+#define DBJ_LOG_DUMP_MAX 4096
+#endif
+	typedef enum DBJ_LOG_DUMP_ENUM {
+		DBJ_LOG_DUMP_HEX,
+		DBJ_LOG_DUMP_BASE64
+	} DBJ_LOG_DUMP;
+
+	void dbj_simple_log_dump(int /*level*/, const char* /*file*/, int /*line*/,
+		const void* /*data*/, size_t /*len*/, const char* /*label*/, int /*DBJ_LOG_DUMP*/);
+	/* instead of DBJ_LOG_DUMP_MAX, 0 is no limit */
+	void dbj_log_dump_limit(size_t /*bytes*/);
+
 	// bool dbj_log_setup(int, const char*);
 
+	/////////////////////////////////////////////////////////////////////////////////////
+	/// scope timing
+	/// 
+	/// one line with the duration is logged when the scope ends
+	/// durations are also aggregated per scope: count, min, avg, max, p99
+	/// and dumped at the end, or every DBJ_LOG_SCOPE_DUMP_MS if that is not 0
+#ifndef DBJ_LOG_SCOPE_SITES
+#define DBJ_LOG_SCOPE_SITES 128
+#endif
+#ifndef DBJ_LOG_SCOPE_DUMP_MS
+#define DBJ_LOG_SCOPE_DUMP_MS 0
+#endif
+	typedef struct dbj_log_scope {
+		int level;
+		const char* name;
+		const char* file;
+		int line;
+		/* clock ticks */
+		long long start;
+	} dbj_log_scope;
+
+	dbj_log_scope dbj_log_scope_begin(int /*level*/, const char* /*name*/, const char* /*file*/, int /*line*/);
+	void dbj_log_scope_end(dbj_log_scope*);
+	/* aggregated durations, of all the scopes */
+	void dbj_log_scope_dump(void);
+
 	/////////////////////////////////////////////////////////////////////////////////////
 	// primary usage is through these macros in the back
 	// NOTE: these are active in both debug and release builds
@@ -290,6 +628,32 @@ __inline FILE* dbj_fhandle_file_ptr(dbj_fhandle* self /* const char* options_ */
 #define dbj_log_error(...) dbj_simple_log_log(DBJ_LOG_ERROR, __FILE__, __LINE__, __VA_ARGS__)
 #define dbj_log_fatal(...) dbj_simple_log_log(DBJ_LOG_FATAL, __FILE__, __LINE__, __VA_ARGS__)
 
+#define dbj_log_batch_begin(level_) dbj_simple_log_batch_begin(level_, __FILE__, __LINE__)
+#define dbj_log_batch_line(...) dbj_simple_log_batch_line(__FILE__, __LINE__, __VA_ARGS__)
+#define dbj_log_batch_end() dbj_simple_log_batch_end()
+
+#define dbj_log_hexdump(level_, data_, len_, label_) \
+	dbj_simple_log_dump(level_, __FILE__, __LINE__, data_, len_, label_, DBJ_LOG_DUMP_HEX)
+#define dbj_log_base64(level_, data_, len_, label_) \
+	dbj_simple_log_dump(level_, __FILE__, __LINE__, data_, len_, label_, DBJ_LOG_DUMP_BASE64)
+
+#define dbj_log_scope_enter(var_, level_, name_) \
+	dbj_log_scope var_ = dbj_log_scope_begin(level_, name_, __FILE__, __LINE__)
+#define dbj_log_scope_leave(var_) dbj_log_scope_end(&var_)
+
+#define dbj_log_scope_var_2_(L_) dbj_log_scope_var_##L_
+#define dbj_log_scope_var_(L_) dbj_log_scope_var_2_(L_)
+
+/* ends with the enclosing block, RAII in C++ */
+#ifdef __cplusplus
+#define dbj_log_scope_guard(level_, name_) \
+	dbj_log_scope_guard_ dbj_log_scope_var_(__LINE__){ dbj_log_scope_begin(level_, name_, __FILE__, __LINE__) }
+#else
+#define dbj_log_scope_guard(level_, name_) \
+	__attribute__((cleanup(dbj_log_scope_end))) \
+	dbj_log_scope dbj_log_scope_var_(__LINE__) = dbj_log_scope_begin(level_, name_, __FILE__, __LINE__)
+#endif // __cplusplus
+
 // and these macros are in the front
 // which are much more senisitive to name clash
 // unles you do not use your own set
@@ -302,6 +666,17 @@ __inline FILE* dbj_fhandle_file_ptr(dbj_fhandle* self /* const char* options_ */
 #define LOG_ERROR(...) dbj_log_error(__VA_ARGS__)
 #define LOG_FATAL(...) dbj_log_fatal(__VA_ARGS__)
 
+#define LOG_BATCH_BEGIN(level_) dbj_log_batch_begin(level_)
+#define LOG_BATCH_LINE(...) dbj_log_batch_line(__VA_ARGS__)
+#define LOG_BATCH_END() dbj_log_batch_end()
+
+#define LOG_HEXDUMP(level_, data_, len_, label_) dbj_log_hexdump(level_, data_, len_, label_)
+#define LOG_BASE64(level_, data_, len_, label_) dbj_log_base64(level_, data_, len_, label_)
+
+#define LOG_SCOPE(level_, name_) dbj_log_scope_guard(level_, name_)
+#define LOG_SCOPE_BEGIN(var_, level_, name_) dbj_log_scope_enter(var_, level_, name_)
+#define LOG_SCOPE_END(var_) dbj_log_scope_leave(var_)
+
 #endif // DBJ_USER_DEFINED_MACRO_NAMES
 
 
@@ -311,4 +686,4860 @@ __inline FILE* dbj_fhandle_file_ptr(dbj_fhandle* self /* const char* options_ */
 } // extern "C" 
 #endif // __cplusplus
 
+#ifdef __cplusplus
+struct dbj_log_scope_guard_ {
+	dbj_log_scope scope;
+	~dbj_log_scope_guard_() { dbj_log_scope_end(&scope); }
+};
+#endif // __cplusplus
+
+/* single header: the implementation, once, in one compilation unit */
+#ifdef DBJ_SIMPLELOG_IMPLEMENTATION
+#ifdef __cplusplus
+extern "C" {
+#endif // __cplusplus
+
+/* (c) 2019-2020 by dbj.org   -- LICENSE DBJ -- https://dbj.org/license_dbj/ */
+/*
+ * Copyright (c) 2017 rxi
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, including without limitation the
+ * rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+ * sell copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ */
+
+/* the implementation, under DBJ_SIMPLELOG_IMPLEMENTATION */
+#ifndef _DBJ_SIMPLE_LOG_C_INCLUDED_
+#define _DBJ_SIMPLE_LOG_C_INCLUDED_
+
+//#ifdef __STDC_ALLOC_LIB__
+//#define __STDC_WANT_LIB_EXT2__ 1
+//#else
+//#define _POSIX_C_SOURCE 200809L
+//#endif
+
+ // pch.h is implicitly included
+ // and this is in there
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <crtdbg.h>
+#include <errno.h>
+#include <io.h> // is a tty
+#include <wchar.h>
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <emmintrin.h>
+#define DBJ_LOG_SSE2
+#endif
+#if defined(_M_X64) || defined(__x86_64__)
+#include <nmmintrin.h>
+#define DBJ_LOG_CRC_HW
+#endif
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+#ifdef DBJ_LOG_NET_ENABLED
+// DBJ_LOG_NET, after the lean Windows.h, not to clash with the old winsock.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "ws2_32.lib")
+#else
+static_assert(0 == ((DBJ_LOG_DEFAULT_SETUP) & DBJ_LOG_NET),
+	"DBJ_LOG_NET is in the setup, define DBJ_LOG_NET_ENABLED before the implementation is included");
+#endif // DBJ_LOG_NET_ENABLED
+
+static const char* level_names[] = {
+  "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
+};
+
+#ifndef errno_t
+typedef int errno_t;
+#endif
+
+// dbj::simplelog::log_lock_function_ptr 
+// user_data is user data pointer
+// lock == true  -- lock
+// lock == false -- unlock
+typedef void (*log_lock_function_ptr)(bool /*lock*/);
+
+// default uses win32 slim reader writer lock
+// implemented in here
+// user_data is unused 
+static void  default_protector_function(bool /*lock*/);
+
+/*
+setup specialization
+
+by default the setup is the compile time constant, DBJ_LOG_DEFAULT_SETUP
+thus the branches on it are folded away and the lock is called directly
+define DBJ_LOG_RUNTIME_SETUP to have it decided at runtime, by dbj_simple_log_startup()
+*/
+#ifdef DBJ_LOG_RUNTIME_SETUP
+#define log_setup_mt_ (LOCAL.lock != NULL)
+#define log_setup_console_ (!LOCAL.no_console)
+#define log_setup_file_line_ (LOCAL.file_line_show)
+#define log_setup_full_stamp_ (LOCAL.full_time_stamp)
+#define log_setup_tsc_stamp_ (LOCAL.tsc_stamp)
+#else
+#define log_setup_is_(B_) (0 != ((DBJ_LOG_DEFAULT_SETUP) & (B_)))
+#define log_setup_mt_ log_setup_is_(DBJ_LOG_MT)
+#define log_setup_console_ (!log_setup_is_(DBJ_LOG_NO_CONSOLE))
+#define log_setup_file_line_ log_setup_is_(DBJ_LOG_FILELINE_SHOW)
+#define log_setup_full_stamp_ log_setup_is_(DBJ_LOG_FULL_TIMESTAMP)
+#define log_setup_tsc_stamp_ log_setup_is_(DBJ_LOG_TSC_TIMESTAMP)
+#endif // DBJ_LOG_RUNTIME_SETUP
+
+static struct LOCAL_ {
+	void* user_data;
+	log_lock_function_ptr lock;
+	FILE* fp;
+	int level;
+	int no_console;
+	bool file_line_show;
+	/* default is false, that means: time only */
+	bool full_time_stamp;
+	/* no flush after each line, while this is true */
+	bool flush_suspended;
+	/* DBJ_LOG_TSC_TIMESTAMP */
+	bool tsc_stamp;
+	/* DBJ_LOG_CRC */
+	bool crc;
+	char log_f_name[BUFSIZ];
+} LOCAL = {
+		// defaults
+	.user_data = 0,
+	.lock = 0,
+	.fp = 0,
+	.level = DBJ_LOG_TRACE,
+	.no_console = 0,
+	.file_line_show = false,
+	.full_time_stamp = false,
+	.flush_suspended = false,
+	.tsc_stamp = false,
+	.crc = false,
+	 .log_f_name = {'\0'} };
+
+static const char* set_log_file_name(const char new_name[BUFSIZ]) {
+
+	errno_t rez = strncpy_s(LOCAL.log_f_name, BUFSIZ, new_name, BUFSIZ - 1);
+	DBJ_ASSERT(rez == 0);
+	return LOCAL.log_f_name;
+}
+
+enum { dbj_COLOR_RESET = 0, dbj_LIGHT_GRAY = 1 };
+
+#define VT100_ESC "\x1b["
+#define VT100_RESET VT100_ESC "0m"
+#define VT100_LIGHT_GRAY VT100_ESC "90m"
+#define VT100_LIGHT_BLUE VT100_ESC "94m"
+#define VT100_LIGHT_CYAN VT100_ESC "36m"
+#define VT100_LIGHT_YELLOW VT100_ESC "33m"
+#define VT100_LIGHT_GREEN VT100_ESC "32m"
+#define VT100_LIGHT_RED VT100_ESC "31m"
+#define VT100_LIGHT_MAGENTA VT100_ESC "35m"
+
+static const char* level_colors[] = {
+	/* TRACE */  VT100_LIGHT_BLUE,
+	/* DEBUG */ VT100_LIGHT_CYAN,
+	/* INFO */ VT100_LIGHT_GREEN,
+	/* WARN */ VT100_LIGHT_YELLOW,
+	/* ERROR */ VT100_LIGHT_RED,
+	/* FATAL */ VT100_LIGHT_MAGENTA
+};
+
+static const char* colors_[] = {
+	/* RESET */ VT100_RESET, /* dbj_LIGHT_GRAY */ VT100_LIGHT_GRAY
+};
+
+
+/* one per process, not recursive */
+static SRWLOCK log_lock_ = SRWLOCK_INIT;
+
+static __inline void lock(void) {
+#ifdef DBJ_LOG_RUNTIME_SETUP
+	if (LOCAL.lock) {
+		LOCAL.lock(true);
+	}
+#else
+	if (log_setup_mt_) AcquireSRWLockExclusive(&log_lock_);
+#endif
+}
+
+static __inline void unlock(void) {
+#ifdef DBJ_LOG_RUNTIME_SETUP
+	if (LOCAL.lock) {
+		LOCAL.lock(false);
+	}
+#else
+	if (log_setup_mt_) ReleaseSRWLockExclusive(&log_lock_);
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// log record pool
+///
+/// slabs are made once, one per size class, on the first use
+/// dbj_log_pool_reserve adds more, any time
+/// each thread keeps a short free list per class, given back when the thread ends
+/// records freed on some other thread go back through the
+/// lock free SLIST of their class
+/// empty class is helped by the bigger ones, heap is the last resort
+/// thus steady state logging does no heap calls
+
+#ifndef DBJ_LOG_POOL_TLS_CACHE
+#define DBJ_LOG_POOL_TLS_CACHE 8
+#endif
+
+static const size_t pool_record_sizes_[DBJ_LOG_POOL_CLASSES] = {
+	256, 1024, 4096, 16384
+};
+
+/* heap records are marked with this */
+#define dbj_log_heap_class -1
+
+typedef struct dbj_log_record_ {
+	/* must be first, SLIST entries are MEMORY_ALLOCATION_ALIGNMENT aligned */
+	SLIST_ENTRY link;
+	struct dbj_log_record_* next;
+	DWORD owner;
+	int size_class;
+	size_t capacity;
+	size_t length;
+} dbj_log_record_;
+
+#define dbj_log_record_data(R_) ((char*)((R_) + 1))
+
+static struct {
+	INIT_ONCE once;
+	/* slabs are added under this, records are taken without it */
+	SRWLOCK grow;
+	/* thread end callback, gives back the thread cache */
+	DWORD fls;
+	LONG64 volatile capacity[DBJ_LOG_POOL_CLASSES];
+	SLIST_HEADER free_list[DBJ_LOG_POOL_CLASSES];
+	LONG64 volatile allocations[DBJ_LOG_POOL_CLASSES];
+	LONG64 volatile cross_thread_frees[DBJ_LOG_POOL_CLASSES];
+	LONG64 volatile in_use[DBJ_LOG_POOL_CLASSES];
+	LONG64 volatile heap_allocations;
+	LONG64 volatile heap_in_use;
+} POOL = { INIT_ONCE_STATIC_INIT, SRWLOCK_INIT, FLS_OUT_OF_INDEXES };
+
+static __declspec(thread) struct {
+	dbj_log_record_* head;
+	int count;
+} pool_tls_[DBJ_LOG_POOL_CLASSES];
+
+/* this thread will give back its cache when it ends */
+static __declspec(thread) bool pool_tls_registered_;
+
+static size_t pool_stride_(int size_class) {
+	return sizeof(dbj_log_record_) + pool_record_sizes_[size_class];
+}
+
+/* slabs are never freed, they live as long as the process */
+static bool pool_slab_add_(int size_class, int records)
+{
+	const size_t stride = pool_stride_(size_class);
+	char* slab = (char*)_aligned_malloc(stride * records, MEMORY_ALLOCATION_ALIGNMENT);
+	// no slab, no problem, heap will be used
+	if (!slab) return false;
+
+	for (int j = 0; j < records; ++j)
+	{
+		dbj_log_record_* rec = (dbj_log_record_*)(slab + stride * j);
+		rec->size_class = size_class;
+		rec->capacity = pool_record_sizes_[size_class];
+		rec->length = 0;
+		InterlockedPushEntrySList(&POOL.free_list[size_class], &rec->link);
+	}
+	InterlockedExchangeAdd64(&POOL.capacity[size_class], records);
+	return true;
+}
+
+/* FLS callback, on the thread that ends */
+static void WINAPI pool_thread_end_(PVOID data_)
+{
+	(void)data_;
+
+	for (int k = 0; k < DBJ_LOG_POOL_CLASSES; ++k)
+	{
+		while (pool_tls_[k].head) {
+			dbj_log_record_* rec = pool_tls_[k].head;
+			pool_tls_[k].head = rec->next;
+			InterlockedPushEntrySList(&POOL.free_list[k], &rec->link);
+		}
+		pool_tls_[k].count = 0;
+	}
+	pool_tls_registered_ = false;
+}
+
+static BOOL CALLBACK pool_make_(INIT_ONCE* once_, PVOID param_, PVOID* context_)
+{
+	(void)once_; (void)param_; (void)context_;
+
+	POOL.fls = FlsAlloc(pool_thread_end_);
+
+	for (int k = 0; k < DBJ_LOG_POOL_CLASSES; ++k)
+	{
+		InitializeSListHead(&POOL.free_list[k]);
+		pool_slab_add_(k, DBJ_LOG_POOL_RECORDS);
+	}
+	return TRUE;
+}
+
+bool dbj_log_pool_reserve(int records_per_class)
+{
+	InitOnceExecuteOnce(&POOL.once, pool_make_, NULL, NULL);
+
+	bool rez = true;
+	AcquireSRWLockExclusive(&POOL.grow);
+	for (int k = 0; k < DBJ_LOG_POOL_CLASSES; ++k)
+	{
+		const LONG64 missing = records_per_class - POOL.capacity[k];
+		if (missing > 0 && !pool_slab_add_(k, (int)missing)) rez = false;
+	}
+	ReleaseSRWLockExclusive(&POOL.grow);
+	return rez;
+}
+
+/* size is payload size, including the terminating zero */
+static dbj_log_record_* record_alloc_(size_t size)
+{
+	InitOnceExecuteOnce(&POOL.once, pool_make_, NULL, NULL);
+
+	dbj_log_record_* rec = NULL;
+
+	// empty class is not the end, the next one is bigger and fits too
+	for (int k = 0; k < DBJ_LOG_POOL_CLASSES && !rec; ++k)
+	{
+		if (pool_record_sizes_[k] < size) continue;
+
+		if (pool_tls_[k].head) {
+			rec = pool_tls_[k].head;
+			pool_tls_[k].head = rec->next;
+			pool_tls_[k].count -= 1;
+		}
+		else {
+			rec = (dbj_log_record_*)InterlockedPopEntrySList(&POOL.free_list[k]);
+		}
+
+		if (rec) {
+			InterlockedIncrement64(&POOL.allocations[k]);
+			InterlockedIncrement64(&POOL.in_use[k]);
+		}
+	}
+
+	if (!rec) {
+		rec = (dbj_log_record_*)_aligned_malloc(sizeof(dbj_log_record_) + size, MEMORY_ALLOCATION_ALIGNMENT);
+		if (!rec) return NULL;
+		rec->size_class = dbj_log_heap_class;
+		rec->capacity = size;
+		InterlockedIncrement64(&POOL.heap_allocations);
+		InterlockedIncrement64(&POOL.heap_in_use);
+	}
+
+	rec->next = NULL;
+	rec->owner = GetCurrentThreadId();
+	rec->length = 0;
+	return rec;
+}
+
+/* without the thread end callback the cache would be lost with the thread */
+static bool pool_tls_register_(void)
+{
+	if (pool_tls_registered_) return true;
+	if (POOL.fls == FLS_OUT_OF_INDEXES || !FlsSetValue(POOL.fls, (PVOID)1)) return false;
+	pool_tls_registered_ = true;
+	return true;
+}
+
+/* can be called from any thread */
+static void record_free_(dbj_log_record_* rec)
+{
+	if (!rec) return;
+
+	const int k = rec->size_class;
+
+	if (k == dbj_log_heap_class) {
+		InterlockedDecrement64(&POOL.heap_in_use);
+		_aligned_free(rec);
+		return;
+	}
+
+	InterlockedDecrement64(&POOL.in_use[k]);
+
+	if (rec->owner == GetCurrentThreadId() && pool_tls_[k].count < DBJ_LOG_POOL_TLS_CACHE
+		&& pool_tls_register_()) {
+		rec->next = pool_tls_[k].head;
+		pool_tls_[k].head = rec;
+		pool_tls_[k].count += 1;
+		return;
+	}
+
+	if (rec->owner != GetCurrentThreadId())
+		InterlockedIncrement64(&POOL.cross_thread_frees[k]);
+
+	InterlockedPushEntrySList(&POOL.free_list[k], &rec->link);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// fast formatting
+///
+/// printf, as the UCRT has it, is formatted here, straight into the record
+/// %d %i %u %o %x %X %c %s %p %% with flags, width, precision and all the length modifiers
+/// %ls %S %lc %C are UTF-8 here, not the current code page
+/// %f %g are exact here, in 128 bits, for the values logs usually have
+/// the rest of them, %e %a and the rounding ties are handed over to snprintf, one by one
+/// %n, %Z and the invalid formats only are left to vsnprintf, as they are
+
+enum { fmt_unsupported_ = -2, fmt_truncated_ = -3 };
+
+static const char digit_pairs_[201] =
+"00010203040506070809"
+"10111213141516171819"
+"20212223242526272829"
+"30313233343536373839"
+"40414243444546474849"
+"50515253545556575859"
+"60616263646566676869"
+"70717273747576777879"
+"80818283848586878889"
+"90919293949596979899";
+
+/* writes backwards from the end, returns the number of digits */
+static int u64_to_dec_(unsigned long long val, char* end)
+{
+	char* p = end;
+	while (val >= 100) {
+		const unsigned idx = (unsigned)(val % 100) * 2;
+		val /= 100;
+		*--p = digit_pairs_[idx + 1];
+		*--p = digit_pairs_[idx];
+	}
+	if (val >= 10) {
+		const unsigned idx = (unsigned)val * 2;
+		*--p = digit_pairs_[idx + 1];
+		*--p = digit_pairs_[idx];
+	}
+	else {
+		*--p = (char)('0' + val);
+	}
+	return (int)(end - p);
+}
+
+static int u64_to_oct_(unsigned long long val, char* end)
+{
+	char* p = end;
+	do {
+		*--p = (char)('0' + (val & 7));
+		val >>= 3;
+	} while (val);
+	return (int)(end - p);
+}
+
+static int u64_to_hex_(unsigned long long val, char* end, bool upper)
+{
+	const char* digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+	char* p = end;
+	do {
+		*--p = digits[val & 0xF];
+		val >>= 4;
+	} while (val);
+	return (int)(end - p);
+}
+
+typedef struct fmt_out_ {
+	char* p;
+	char* end;
+	bool overflow;
+} fmt_out_;
+
+static void fmt_put_(fmt_out_* out, const char* src, size_t n)
+{
+	if ((size_t)(out->end - out->p) < n) {
+		out->overflow = true;
+		return;
+	}
+	memcpy(out->p, src, n);
+	out->p += n;
+}
+
+static void fmt_fill_(fmt_out_* out, char c, int n)
+{
+	if (n <= 0) return;
+	if (out->end - out->p < n) {
+		out->overflow = true;
+		return;
+	}
+	memset(out->p, c, (size_t)n);
+	out->p += n;
+}
+
+typedef struct fmt_spec_ {
+	bool minus, zero, plus, space, hash;
+	/* -1 is not given, -2 is '*' */
+	int width;
+	int precision;
+	/* 0, 'H' for hh, 'h', 'l' or 'w', 'L' for ll I64 j, 'z' for z t I, 'D' for long double */
+	char length;
+	char conv;
+} fmt_spec_;
+
+/* f is just after the '%', returns just after the conversion or NULL if unsupported */
+static const char* fmt_parse_(const char* f, fmt_spec_* s)
+{
+	memset(s, 0, sizeof(*s));
+	s->width = s->precision = -1;
+
+	for (;; ++f) {
+		if (*f == '-') s->minus = true;
+		else if (*f == '0') s->zero = true;
+		else if (*f == '+') s->plus = true;
+		else if (*f == ' ') s->space = true;
+		else if (*f == '#') s->hash = true;
+		else break;
+	}
+
+	if (*f == '*') {
+		s->width = -2; ++f;
+	}
+	else if (*f >= '0' && *f <= '9') {
+		s->width = 0;
+		while (*f >= '0' && *f <= '9') s->width = s->width * 10 + (*f++ - '0');
+	}
+
+	if (*f == '.') {
+		++f;
+		if (*f == '*') {
+			s->precision = -2; ++f;
+		}
+		else {
+			s->precision = 0;
+			while (*f >= '0' && *f <= '9') s->precision = s->precision * 10 + (*f++ - '0');
+		}
+	}
+
+	switch (*f) {
+	case 'h':
+		++f;
+		s->length = 'h';
+		if (*f == 'h') { ++f; s->length = 'H'; }
+		break;
+	case 'l':
+		++f;
+		s->length = 'l';
+		if (*f == 'l') { ++f; s->length = 'L'; }
+		break;
+	case 'w':
+		++f;
+		s->length = 'l';
+		break;
+	case 'j':
+		++f;
+		s->length = 'L';
+		break;
+	case 'z': case 't':
+		++f;
+		s->length = 'z';
+		break;
+	case 'L':
+		++f;
+		s->length = 'D';
+		break;
+	case 'I':
+		++f;
+		if (f[0] == '6' && f[1] == '4') { f += 2; s->length = 'L'; }
+		else if (f[0] == '3' && f[1] == '2') { f += 2; s->length = 0; }
+		else s->length = 'z';
+		break;
+	default:
+		break;
+	}
+
+	s->conv = *f;
+	switch (*f) {
+	case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+		if (s->length == 'D') return NULL;
+		break;
+	case 'c': case 's': case 'C': case 'S':
+		/* %lc %ls %wc %ws are wide, as are %C and %S, %hc %hs %hC %hS are narrow */
+		if (s->length && s->length != 'l' && s->length != 'h') return NULL;
+		break;
+	case 'p':
+		if (s->length) return NULL;
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		if (s->length && s->length != 'l' && s->length != 'D') return NULL;
+		break;
+	default:
+		return NULL;
+	}
+	return f + 1;
+}
+
+static bool fmt_supported_(const char* f)
+{
+	fmt_spec_ spec;
+	while ((f = strchr(f, '%')) != NULL) {
+		++f;
+		if (*f == '%') { ++f; continue; }
+		if ((f = fmt_parse_(f, &spec)) == NULL) return false;
+	}
+	return true;
+}
+
+static void fmt_integer_(fmt_out_* out, const fmt_spec_* s, unsigned long long magnitude, bool negative)
+{
+	char digits[24];
+	char* end = digits + sizeof(digits);
+	int n = 0;
+	const bool hex = (s->conv == 'x' || s->conv == 'X' || s->conv == 'p');
+
+	if (!(s->precision == 0 && magnitude == 0))
+		n = hex ? u64_to_hex_(magnitude, end, s->conv != 'x')
+		: s->conv == 'o' ? u64_to_oct_(magnitude, end)
+		: u64_to_dec_(magnitude, end);
+
+	char sign = 0;
+	if (s->conv == 'd' || s->conv == 'i')
+		sign = negative ? '-' : s->plus ? '+' : s->space ? ' ' : 0;
+
+	const char* prefix = (s->hash && magnitude && s->conv == 'x') ? "0x"
+		: (s->hash && magnitude && s->conv == 'X') ? "0X" : "";
+	const int prefix_len = (int)strlen(prefix) + (sign ? 1 : 0);
+
+	int zeros = s->precision > n ? s->precision - n : 0;
+	/* %#o, the first digit is 0 */
+	if (s->hash && s->conv == 'o' && zeros == 0 && (n == 0 || end[-n] != '0')) zeros = 1;
+	int pad = s->width - (prefix_len + zeros + n);
+
+	if (!s->minus && s->zero && s->precision < 0) {
+		zeros += pad > 0 ? pad : 0;
+		pad = 0;
+	}
+	if (!s->minus) fmt_fill_(out, ' ', pad);
+	if (sign) fmt_put_(out, &sign, 1);
+	fmt_put_(out, prefix, strlen(prefix));
+	fmt_fill_(out, '0', zeros);
+	fmt_put_(out, end - n, (size_t)n);
+	if (s->minus) fmt_fill_(out, ' ', pad);
+}
+
+static const unsigned long long pow10_[18] = {
+	1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+	100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+	10000000000000ULL, 100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL,
+	100000000000000000ULL
+};
+
+/* returns the low 64 bits of a * b, hi gets the high 64 */
+static unsigned long long fmt_mul_64_(unsigned long long a, unsigned long long b, unsigned long long* hi)
+{
+	const unsigned long long a_lo = a & 0xFFFFFFFFULL, a_hi = a >> 32;
+	const unsigned long long b_lo = b & 0xFFFFFFFFULL, b_hi = b >> 32;
+	const unsigned long long ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo;
+	const unsigned long long mid = (ll >> 32) + (lh & 0xFFFFFFFFULL) + (hl & 0xFFFFFFFFULL);
+	*hi = a_hi * b_hi + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | (ll & 0xFFFFFFFFULL);
+}
+
+/*
+m * 2^e * 10^p rounded to the integer, exactly, p is 0 .. 17
+m is below 2^53 thus the product is below 2^110
+false if it does not fit 64 bits, or on the exact tie, CRT decides those
+*/
+static bool fmt_scaled_(unsigned long long m, int e, int p, unsigned long long* q)
+{
+	unsigned long long hi;
+	const unsigned long long lo = fmt_mul_64_(m, pow10_[p], &hi);
+
+	if (e >= 0) {
+		if (hi || e >= 64 || (e && (lo >> (64 - e)))) return false;
+		*q = lo << e;
+		return true;
+	}
+
+	const int s = -e;
+	/* below the half */
+	if (s > 110) {
+		*q = 0;
+		return true;
+	}
+
+	unsigned long long rest_hi, rest_lo, half_hi, half_lo;
+	if (s >= 64) {
+		const int t = s - 64;
+		*q = hi >> t;
+		rest_hi = hi & ((1ULL << t) - 1);
+		rest_lo = lo;
+		half_hi = t ? 1ULL << (t - 1) : 0;
+		half_lo = t ? 0 : 1ULL << 63;
+	}
+	else {
+		if (hi >> s) return false;
+		*q = (lo >> s) | (hi << (64 - s));
+		rest_hi = 0;
+		rest_lo = lo & ((1ULL << s) - 1);
+		half_hi = 0;
+		half_lo = 1ULL << (s - 1);
+	}
+
+	if (rest_hi == half_hi && rest_lo == half_lo) return false;
+	if (rest_hi > half_hi || (rest_hi == half_hi && rest_lo > half_lo)) {
+		if (*q == ~0ULL) return false;
+		*q += 1;
+	}
+	return true;
+}
+
+/* a = m * 2^e, a >= 10^t, exactly, t is -5 .. 17 */
+static bool fmt_ge_pow10_(double a, unsigned long long m, int e, int t)
+{
+	/* 10^t is exact in double up to 10^22 */
+	if (t >= 0) return a >= (double)pow10_[t];
+	if (e >= 0) return true;
+
+	/* m * 10^-t >= 2^-e */
+	unsigned long long hi;
+	const unsigned long long lo = fmt_mul_64_(m, pow10_[-t], &hi);
+	const int s = -e;
+	if (s >= 128) return false;
+	return s >= 64 ? (hi >> (s - 64)) != 0 : (hi != 0 || (lo >> s) != 0);
+}
+
+/*
+%f %F %g %G, false if it is to be done by snprintf
+that is %g in the %e style, infinity, NaN, precision above 17,
+the value too big for 64 bits and the exact ties
+*/
+static bool fmt_float_(fmt_out_* out, const fmt_spec_* s, double v)
+{
+	unsigned long long bits;
+	memcpy(&bits, &v, sizeof(bits));
+
+	const bool negative = (bits >> 63) != 0;
+	const int biased = (int)((bits >> 52) & 0x7FF);
+	unsigned long long m = bits & ((1ULL << 52) - 1);
+
+	if (biased == 0x7FF) return false;
+	int e = -1074;
+	if (biased) {
+		m |= 1ULL << 52;
+		e = biased - 1075;
+	}
+
+	int p = s->precision < 0 ? 6 : s->precision;
+	unsigned long long q = 0;
+	const bool g = (s->conv == 'g' || s->conv == 'G');
+
+	if (!g) {
+		if (p > 17 || !fmt_scaled_(m, e, p, &q)) return false;
+	}
+	else {
+		if (p == 0) p = 1;
+		if (p > 17) return false;
+
+		/* x is the exponent %e would show */
+		int x = 0;
+		if (m) {
+			const double a = negative ? -v : v;
+			if (a < 1e-5 || a >= 1e17) return false;
+
+			/* floor(log10(a)), from the binary exponent, then made exact */
+			int t = (biased - 1023) * 1233 / 4096;
+			if (t < -5) t = -5;
+			if (t > 16) t = 16;
+			while (t > -5 && !fmt_ge_pow10_(a, m, e, t)) --t;
+			while (t < 16 && fmt_ge_pow10_(a, m, e, t + 1)) ++t;
+
+			x = t;
+			if (p - 1 - x < 0 || p - 1 - x > 17) return false;
+			if (!fmt_scaled_(m, e, p - 1 - x, &q)) return false;
+			/* rounded up into the next decade */
+			if (q == pow10_[p]) ++x;
+		}
+		if (x < -4 || x >= p) return false;
+
+		p = p - 1 - x;
+		if (p > 17 || !fmt_scaled_(m, e, p, &q)) return false;
+	}
+
+	char digits[48];
+	char* const end = digits + sizeof(digits);
+	char* w = end;
+
+	const unsigned long long int_part = q / pow10_[p];
+	unsigned long long frac = q % pow10_[p];
+	int frac_len = p;
+
+	/* %g: no trailing zeros, unless # */
+	if (g && !s->hash)
+		while (frac_len > 0 && frac % 10 == 0) {
+			frac /= 10;
+			--frac_len;
+		}
+
+	for (int j = 0; j < frac_len; ++j) {
+		*--w = (char)('0' + frac % 10);
+		frac /= 10;
+	}
+	if (frac_len > 0 || s->hash) *--w = '.';
+	w -= u64_to_dec_(int_part, w);
+
+	const int n = (int)(end - w);
+	const char sign = negative ? '-' : s->plus ? '+' : s->space ? ' ' : 0;
+	const int pad = s->width - n - (sign ? 1 : 0);
+
+	if (!s->minus && !s->zero) fmt_fill_(out, ' ', pad);
+	if (sign) fmt_put_(out, &sign, 1);
+	if (!s->minus && s->zero) fmt_fill_(out, '0', pad);
+	fmt_put_(out, w, (size_t)n);
+	if (s->minus) fmt_fill_(out, ' ', pad);
+	return true;
+}
+
+/*
+UTF-16 to UTF-8, at most cap bytes, whole code points only
+unpaired surrogates become U+FFFD
+*consumed is how many wchar_t were used, returns the bytes written
+SSE2: 8 at once while they are all ASCII, as they mostly are in logs
+*/
+static size_t utf16_to_utf8_(const wchar_t* src, size_t n, char* dst, size_t cap, size_t* consumed)
+{
+	static_assert(sizeof(wchar_t) == 2, "wchar_t is UTF-16 on Windows");
+
+	size_t i = 0, w = 0;
+
+	while (i < n)
+	{
+#ifdef DBJ_LOG_SSE2
+		while (i + 8 <= n && w + 8 <= cap) {
+			const __m128i units_ = _mm_loadu_si128((const __m128i*)(src + i));
+			const __m128i high_ = _mm_and_si128(units_, _mm_set1_epi16((short)0xFF80));
+			if (_mm_movemask_epi8(_mm_cmpeq_epi16(high_, _mm_setzero_si128())) != 0xFFFF) break;
+			_mm_storel_epi64((__m128i*)(dst + w), _mm_packus_epi16(units_, units_));
+			i += 8;
+			w += 8;
+		}
+		if (i == n) break;
+#endif // DBJ_LOG_SSE2
+
+		unsigned cp = (unsigned short)src[i];
+		size_t used = 1, need;
+
+		if (cp < 0x80) need = 1;
+		else if (cp < 0x800) need = 2;
+		else if (cp >= 0xD800 && cp <= 0xDFFF) {
+			const unsigned next = i + 1 < n ? (unsigned short)src[i + 1] : 0;
+			if (cp <= 0xDBFF && next >= 0xDC00 && next <= 0xDFFF) {
+				cp = 0x10000 + ((cp - 0xD800) << 10) + (next - 0xDC00);
+				used = 2;
+				need = 4;
+			}
+			else {
+				cp = 0xFFFD;
+				need = 3;
+			}
+		}
+		else need = 3;
+
+		if (w + need > cap) break;
+
+		switch (need) {
+		case 1:
+			dst[w] = (char)cp;
+			break;
+		case 2:
+			dst[w] = (char)(0xC0 | (cp >> 6));
+			dst[w + 1] = (char)(0x80 | (cp & 0x3F));
+			break;
+		case 3:
+			dst[w] = (char)(0xE0 | (cp >> 12));
+			dst[w + 1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+			dst[w + 2] = (char)(0x80 | (cp & 0x3F));
+			break;
+		default:
+			dst[w] = (char)(0xF0 | (cp >> 18));
+			dst[w + 1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+			dst[w + 2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+			dst[w + 3] = (char)(0x80 | (cp & 0x3F));
+			break;
+		}
+		w += need;
+		i += used;
+	}
+
+	*consumed = i;
+	return w;
+}
+
+/* UTF-8 bytes of the code point src starts with, as utf16_to_utf8_ makes them */
+static size_t utf8_bytes_next_(const wchar_t* src, size_t n)
+{
+	const unsigned cp = (unsigned short)src[0];
+	if (cp < 0x80) return 1;
+	if (cp < 0x800) return 2;
+	if (cp >= 0xD800 && cp <= 0xDBFF && n > 1) {
+		const unsigned next = (unsigned short)src[1];
+		if (next >= 0xDC00 && next <= 0xDFFF) return 4;
+	}
+	return 3;
+}
+
+/*
+wide string straight into the output, no intermediate buffer
+width and precision are in UTF-8 bytes, as for the narrow strings
+precision is applied to the bytes made, never splitting the character,
+as the CRT does it, the same whatever the room left in the output
+*/
+static void fmt_wide_string_(fmt_out_* out, const fmt_spec_* s, const wchar_t* str, size_t len)
+{
+	const size_t room_ = (size_t)(out->end - out->p);
+	const size_t limit_ = s->precision >= 0 ? (size_t)s->precision : (size_t)-1;
+	const size_t cap_ = limit_ < room_ ? limit_ : room_;
+
+	size_t consumed_ = 0;
+	const size_t n = utf16_to_utf8_(str, len, out->p, cap_, &consumed_);
+
+	/* stopped by the room, and the precision would take the next one too: output is made bigger */
+	if (consumed_ < len && cap_ < limit_ && n + utf8_bytes_next_(str + consumed_, len - consumed_) <= limit_) {
+		out->overflow = true;
+		return;
+	}
+	DBJ_ASSERT(n <= limit_);
+
+	const int pad = s->width - (int)n;
+	if (pad > 0 && !s->minus) {
+		if ((size_t)(out->end - out->p) < n + (size_t)pad) {
+			out->overflow = true;
+			return;
+		}
+		memmove(out->p + pad, out->p, n);
+		memset(out->p, ' ', (size_t)pad);
+		out->p += pad + n;
+		return;
+	}
+	out->p += n;
+	if (s->minus) fmt_fill_(out, ' ', pad);
+}
+
+static void fmt_string_(fmt_out_* out, const fmt_spec_* s, const char* str, size_t len)
+{
+	const int pad = s->width - (int)len;
+	if (!s->minus) fmt_fill_(out, ' ', pad);
+	fmt_put_(out, str, len);
+	if (s->minus) fmt_fill_(out, ' ', pad);
+}
+
+/*
+returns the length written, fmt_unsupported_ or fmt_truncated_
+args are copied, not consumed
+*/
+static int fast_format_(char* buf, size_t cap, const char* fmt, va_list args)
+{
+	DBJ_ASSERT(cap > 0);
+
+	if (!fmt_supported_(fmt)) return fmt_unsupported_;
+
+	va_list ap;
+	va_copy(ap, args);
+
+	/* one is left for the terminating zero */
+	fmt_out_ out = { buf, buf + cap - 1, false };
+	fmt_spec_ spec;
+
+	for (const char* f = fmt; *f; )
+	{
+		const char* pct = strchr(f, '%');
+		if (!pct) {
+			fmt_put_(&out, f, strlen(f));
+			break;
+		}
+		fmt_put_(&out, f, (size_t)(pct - f));
+		f = pct + 1;
+
+		if (*f == '%') {
+			fmt_put_(&out, "%", 1);
+			++f;
+			continue;
+		}
+
+		f = fmt_parse_(f, &spec);
+
+		if (spec.width == -2) {
+			spec.width = va_arg(ap, int);
+			if (spec.width < 0) {
+				spec.minus = true;
+				spec.width = -spec.width;
+			}
+		}
+		if (spec.precision == -2) {
+			spec.precision = va_arg(ap, int);
+			if (spec.precision < 0) spec.precision = -1;
+		}
+
+		switch (spec.conv) {
+		case 'd': case 'i': {
+			long long val = spec.length == 'L' ? va_arg(ap, long long)
+				: spec.length == 'l' ? va_arg(ap, long)
+				: spec.length == 'z' ? (long long)va_arg(ap, ptrdiff_t)
+				: spec.length == 'h' ? (short)va_arg(ap, int)
+				: spec.length == 'H' ? (signed char)va_arg(ap, int)
+				: va_arg(ap, int);
+			const unsigned long long magnitude = val < 0 ? 0ULL - (unsigned long long)val : (unsigned long long)val;
+			fmt_integer_(&out, &spec, magnitude, val < 0);
+			break;
+		}
+		case 'u': case 'o': case 'x': case 'X': {
+			unsigned long long val = spec.length == 'L' ? va_arg(ap, unsigned long long)
+				: spec.length == 'l' ? va_arg(ap, unsigned long)
+				: spec.length == 'z' ? va_arg(ap, size_t)
+				: spec.length == 'h' ? (unsigned short)va_arg(ap, unsigned int)
+				: spec.length == 'H' ? (unsigned char)va_arg(ap, unsigned int)
+				: va_arg(ap, unsigned int);
+			fmt_integer_(&out, &spec, val, false);
+			break;
+		}
+		case 'p': {
+			/* as the UCRT does it, all the digits, upper case, no 0x */
+			spec.precision = (int)(2 * sizeof(void*));
+			spec.hash = false;
+			fmt_integer_(&out, &spec, (unsigned long long)(uintptr_t)va_arg(ap, void*), false);
+			break;
+		}
+		case 'C': case 'c': {
+			if (spec.conv == 'C' ? spec.length != 'h' : spec.length == 'l') {
+				/* wint_t is promoted to int */
+				const wchar_t c = (wchar_t)va_arg(ap, int);
+				fmt_wide_string_(&out, &spec, &c, 1);
+				break;
+			}
+			const char c = (char)va_arg(ap, int);
+			fmt_string_(&out, &spec, &c, 1);
+			break;
+		}
+		case 'S': case 's': {
+			if (spec.conv == 'S' ? spec.length != 'h' : spec.length == 'l') {
+				const wchar_t* wstr = va_arg(ap, const wchar_t*);
+				if (!wstr) wstr = L"(null)";
+				/* each wchar_t makes at least one byte */
+				const size_t len = spec.precision >= 0 ? wcsnlen(wstr, (size_t)spec.precision) : wcslen(wstr);
+				fmt_wide_string_(&out, &spec, wstr, len);
+				break;
+			}
+			const char* str = va_arg(ap, const char*);
+			if (!str) str = "(null)";
+			const size_t len = spec.precision >= 0 ? strnlen(str, (size_t)spec.precision) : strlen(str);
+			fmt_string_(&out, &spec, str, len);
+			break;
+		}
+		default: {
+			/* long double is double, on Windows */
+			const double val = spec.length == 'D' ? (double)va_arg(ap, long double) : va_arg(ap, double);
+			if ((spec.conv == 'f' || spec.conv == 'F' || spec.conv == 'g' || spec.conv == 'G')
+				&& fmt_float_(&out, &spec, val)) break;
+
+			/* rebuild the single spec for snprintf */
+			char one_spec[32] = { '%' };
+			char* w = one_spec + 1;
+			if (spec.minus) *w++ = '-';
+			if (spec.zero)  *w++ = '0';
+			if (spec.plus)  *w++ = '+';
+			if (spec.space) *w++ = ' ';
+			if (spec.hash)  *w++ = '#';
+			char digits[12];
+			if (spec.width >= 0) {
+				const int n = u64_to_dec_((unsigned)spec.width, digits + sizeof(digits));
+				memcpy(w, digits + sizeof(digits) - n, (size_t)n);
+				w += n;
+			}
+			if (spec.precision >= 0) {
+				const int n = u64_to_dec_((unsigned)spec.precision, digits + sizeof(digits));
+				*w++ = '.';
+				memcpy(w, digits + sizeof(digits) - n, (size_t)n);
+				w += n;
+			}
+			*w++ = spec.conv;
+			*w = '\0';
+
+			char number[512];
+			const int len = snprintf(number, sizeof(number), one_spec, val);
+			if (len < 0 || (size_t)len >= sizeof(number)) {
+				va_end(ap);
+				return fmt_unsupported_;
+			}
+			fmt_put_(&out, number, (size_t)len);
+			break;
+		}
+		} // switch
+	}
+
+	va_end(ap);
+
+	if (out.overflow) return fmt_truncated_;
+
+	*out.p = '\0';
+	return (int)(out.p - buf);
+}
+
+/*
+format into the record big enough, NULL on encoding error
+pool classes first, then the heap, twice as big each time
+*/
+static dbj_log_record_* record_format_(const char* fmt, va_list args)
+{
+	dbj_log_record_* rec = NULL;
+	int len = fmt_unsupported_;
+
+	for (size_t size_ = pool_record_sizes_[0]; size_ <= INT_MAX; )
+	{
+		rec = record_alloc_(size_);
+		if (!rec) return NULL;
+
+		len = fast_format_(dbj_log_record_data(rec), rec->capacity, fmt, args);
+
+		if (len >= 0) {
+			rec->length = (size_t)len;
+			return rec;
+		}
+		size_ = 2 * rec->capacity;
+		record_free_(rec);
+		if (len == fmt_unsupported_) break;
+	}
+
+	// %n, %Z or not a format at all
+	va_list probe;
+	va_copy(probe, args);
+	len = vsnprintf(NULL, 0, fmt, probe);
+	va_end(probe);
+
+	if (len < 0) return NULL;
+
+	rec = record_alloc_((size_t)len + 1);
+	if (!rec) return NULL;
+
+	len = vsnprintf(dbj_log_record_data(rec), rec->capacity, fmt, args);
+	rec->length = len < 0 ? 0 : (size_t)len;
+	return rec;
+}
+
+void dbj_log_pool_get_stats(dbj_log_pool_stats* stats)
+{
+	DBJ_ASSERT(stats);
+
+	for (int k = 0; k < DBJ_LOG_POOL_CLASSES; ++k)
+	{
+		stats->record_size[k] = pool_record_sizes_[k];
+		stats->capacity[k] = (size_t)POOL.capacity[k];
+		stats->allocations[k] = POOL.allocations[k];
+		stats->cross_thread_frees[k] = POOL.cross_thread_frees[k];
+		stats->in_use[k] = POOL.in_use[k];
+	}
+	stats->heap_allocations = POOL.heap_allocations;
+	stats->heap_in_use = POOL.heap_in_use;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// line prefix templates
+///
+/// static parts of the line prefix are made once, at setup
+/// for every level x {colour, no colour} x {file line, none}
+/// line is then assembled by memcpy, around the timestamp, file and line
+///
+/// console: <stamp><head>[<file><mid><line><tail>]<message>
+/// file   : <stamp><head>[<file><mid><line><tail>]<message>
+
+typedef struct prefix_template_ {
+	char bytes[32];
+	size_t len;
+} prefix_template_;
+
+static struct {
+	bool made;
+	/* console has accepted the VT100 escapes */
+	bool vt_mode;
+	/* decided at setup, DBJ_LOG_USE_COLOR and stderr is a VT terminal */
+	bool colour;
+	prefix_template_ console_head[DBJ_COUNT_OF(level_names)][2 /*colour*/][2 /*file line*/];
+	prefix_template_ console_mid;
+	prefix_template_ console_tail[2 /*colour*/];
+	prefix_template_ file_head[DBJ_COUNT_OF(level_names)][2 /*file line*/];
+	prefix_template_ file_mid;
+	prefix_template_ file_tail;
+} PREFIX = { false };
+
+static void prefix_template_set_(prefix_template_* tpl, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(tpl->bytes, sizeof(tpl->bytes), fmt, args);
+	va_end(args);
+	DBJ_ASSERT(len > 0 && (size_t)len < sizeof(tpl->bytes));
+	tpl->len = len < 0 ? 0 : (size_t)len;
+}
+
+static void prefix_templates_make_(void)
+{
+#ifdef DBJ_LOG_USE_COLOR
+	PREFIX.colour = PREFIX.vt_mode && _isatty(_fileno(stderr)) != 0;
+#else
+	PREFIX.colour = false;
+#endif
+
+	for (size_t lvl = 0; lvl < DBJ_COUNT_OF(level_names); ++lvl)
+	{
+		for (int colour = 0; colour < 2; ++colour)
+		{
+			const char* level_color = colour ? level_colors[lvl] : "";
+			const char* reset = colour ? colors_[dbj_COLOR_RESET] : "";
+			const char* gray = colour ? colors_[dbj_LIGHT_GRAY] : "";
+
+			prefix_template_set_(&PREFIX.console_head[lvl][colour][1], " %s%-5s%s%s", level_color, level_names[lvl], reset, gray);
+			prefix_template_set_(&PREFIX.console_head[lvl][colour][0], " %s%-5s%s", level_color, level_names[lvl], reset);
+		}
+		prefix_template_set_(&PREFIX.file_head[lvl][1], " %-5s ", level_names[lvl]);
+		prefix_template_set_(&PREFIX.file_head[lvl][0], " %-5s: ", level_names[lvl]);
+	}
+
+	prefix_template_set_(&PREFIX.console_mid, "%s", "(");
+	prefix_template_set_(&PREFIX.console_tail[1], ") : %s", colors_[dbj_COLOR_RESET]);
+	prefix_template_set_(&PREFIX.console_tail[0], "%s", ") : ");
+	prefix_template_set_(&PREFIX.file_mid, "%s", ":");
+	prefix_template_set_(&PREFIX.file_tail, "%s", ": ");
+
+	PREFIX.made = true;
+}
+
+static char* line_put_(char* dst, const void* src, size_t n) {
+	memcpy(dst, src, n);
+	return dst + n;
+}
+
+/* parts of the line, the same for all the targets */
+typedef struct line_parts_ {
+	const char* stamp;
+	size_t stamp_len;
+	const char* file;
+	size_t file_len;
+	int line;
+	/* per thread context, might be empty */
+	const char* context;
+	size_t context_len;
+	/* sampling weight, 1 is not sampled and not shown */
+	unsigned weight;
+	const char* body;
+	size_t body_len;
+} line_parts_;
+
+/* upper bound of the line length */
+static size_t line_size_(const line_parts_* parts)
+{
+	return parts->stamp_len + 3 * sizeof(((prefix_template_*)0)->bytes)
+		+ parts->file_len + 12 + parts->context_len + 16 + parts->body_len + 2;
+}
+
+/*
+returns the length of the line assembled, dst must be big enough
+mid and tail are NULL if file and line are not shown
+*/
+static size_t line_assemble_(char* dst, const line_parts_* parts,
+	const prefix_template_* head, const prefix_template_* mid, const prefix_template_* tail)
+{
+	char* w = line_put_(dst, parts->stamp, parts->stamp_len);
+	w = line_put_(w, head->bytes, head->len);
+
+	if (mid) {
+		char digits[12];
+		const int n = u64_to_dec_((unsigned)parts->line, digits + sizeof(digits));
+		w = line_put_(w, parts->file, parts->file_len);
+		w = line_put_(w, mid->bytes, mid->len);
+		w = line_put_(w, digits + sizeof(digits) - n, (size_t)n);
+		w = line_put_(w, tail->bytes, tail->len);
+	}
+
+	w = line_put_(w, parts->context, parts->context_len);
+
+	if (parts->weight > 1) {
+		char digits[12];
+		const int n = u64_to_dec_(parts->weight, digits + sizeof(digits));
+		w = line_put_(w, "{w=", 3);
+		w = line_put_(w, digits + sizeof(digits) - n, (size_t)n);
+		w = line_put_(w, "} ", 2);
+	}
+
+	w = line_put_(w, parts->body, parts->body_len);
+	*w++ = '\n';
+	return (size_t)(w - dst);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// call site tables, of the sampling, the profile and the scope timing
+///
+/// site is file and line, open addressing, linear probing, sites are never removed
+/// lock free: slot is claimed with CAS, the rest is made, line is written last
+/// file pointers of the same name might differ, then the names are compared
+
+/* the first member of every site table entry */
+typedef struct log_site_ {
+	/* 0 is the free slot, -1 is being claimed, written last */
+	volatile LONG line;
+	const char* file;
+} log_site_;
+
+/* the rest of the entry just claimed, param is given to the find */
+typedef void (*log_site_init_)(log_site_* site, const void* param);
+
+/*
+table of count entries, stride bytes each, count is a power of two
+NULL if not found and not inserted, or if the table is full
+*/
+static log_site_* log_site_find_(void* table, size_t stride, unsigned count,
+	const char* file, int line, bool insert, log_site_init_ init, const void* param)
+{
+	if (line <= 0) return NULL;
+
+	unsigned h = ((unsigned)line * 2654435761u) & (count - 1);
+	unsigned probes = 0;
+
+	while (probes < count)
+	{
+		log_site_* site = (log_site_*)((char*)table + h * stride);
+		const LONG at = site->line;
+
+		if (at == 0) {
+			if (!insert) return NULL;
+			if (InterlockedCompareExchange(&site->line, -1, 0) == 0) {
+				site->file = file;
+				if (init) init(site, param);
+				InterlockedExchange(&site->line, line);
+				return site;
+			}
+			/* look at the same slot again, someone else has taken it */
+			continue;
+		}
+
+		if (at == -1) {
+			/* the other thread is claiming it */
+			YieldProcessor();
+			continue;
+		}
+
+		if (at == line && (site->file == file || 0 == strcmp(site->file, file)))
+			return site;
+
+		h = (h + 1) & (count - 1);
+		++probes;
+	}
+	return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// sampling
+///
+/// fixed 1 in N per level or per call site, site is file and line
+/// adaptive, under the byte/sec budget, busiest sites are sampled down
+/// kept lines carry {w=N}, N lines were represented by that one
+/// decided before any time or formatting work, nothing is done if not set
+
+#define sample_adaptive_max_ (1 << 16)
+
+typedef struct sample_site_ {
+	log_site_ at;
+	/* fixed 1 in N of the site, 0 is the level one */
+	volatile LONG one_in;
+	/* multiplier of the adaptive mode, 1 is none */
+	volatile LONG adaptive;
+	/* bytes kept in the current budget window */
+	volatile LONG64 window_bytes;
+} sample_site_;
+
+static struct {
+	/* anything set at all */
+	volatile LONG on;
+	volatile LONG sites_set;
+	volatile LONG level_one_in[DBJ_LOG_FATAL + 1];
+	/* bytes per second, 0 is no adaptive mode */
+	volatile LONG budget;
+	/* GetTickCount64() at the start of the budget window */
+	volatile LONG64 window_start;
+	volatile LONG64 window_bytes;
+	volatile LONG64 kept;
+	volatile LONG64 dropped;
+	sample_site_ sites[DBJ_LOG_SAMPLE_SITES];
+} SAMPLE;
+
+static void sample_on_update_(void)
+{
+	LONG on_ = SAMPLE.budget > 0 || SAMPLE.sites_set > 0;
+	for (int lvl = 0; lvl <= DBJ_LOG_FATAL; ++lvl)
+		on_ = on_ || SAMPLE.level_one_in[lvl] > 1;
+	InterlockedExchange(&SAMPLE.on, on_);
+}
+
+/* xorshift64*, per thread, no locking */
+static unsigned sample_rand_(void)
+{
+	static __declspec(thread) unsigned long long state_;
+	if (!state_)
+		state_ = 0x9E3779B97F4A7C15ull * ((unsigned long long)GetCurrentThreadId() + 1);
+
+	state_ ^= state_ >> 12;
+	state_ ^= state_ << 25;
+	state_ ^= state_ >> 27;
+	return (unsigned)((state_ * 0x2545F4914F6CDD1Dull) >> 32);
+}
+
+static void sample_site_init_(log_site_* at, const void* param)
+{
+	(void)param;
+	((sample_site_*)at)->adaptive = 1;
+}
+
+static sample_site_* sample_site_find_(const char* file, int line, bool insert)
+{
+	static_assert((DBJ_LOG_SAMPLE_SITES & (DBJ_LOG_SAMPLE_SITES - 1)) == 0,
+		"DBJ_LOG_SAMPLE_SITES must be a power of two");
+	static_assert(offsetof(sample_site_, at) == 0, "log_site_ must be the first");
+
+	return (sample_site_*)log_site_find_(SAMPLE.sites, sizeof(sample_site_), DBJ_LOG_SAMPLE_SITES,
+		file, line, insert, sample_site_init_, NULL);
+}
+
+/* returns the weight of the line, 0 is dropped */
+static unsigned sample_weight_(int level, const char* file, int line, sample_site_** site)
+{
+	*site = (SAMPLE.budget > 0 || SAMPLE.sites_set > 0)
+		? sample_site_find_(file, line, SAMPLE.budget > 0)
+		: NULL;
+
+	long long one_in = (*site && (*site)->one_in > 0) ? (*site)->one_in : SAMPLE.level_one_in[level];
+	if (one_in < 1) one_in = 1;
+	if (*site) one_in *= (*site)->adaptive;
+	if (one_in > UINT_MAX) one_in = UINT_MAX;
+
+	if (one_in > 1 && (sample_rand_() % (unsigned)one_in) != 0) {
+		InterlockedIncrement64(&SAMPLE.dropped);
+		return 0;
+	}
+	InterlockedIncrement64(&SAMPLE.kept);
+	return (unsigned)one_in;
+}
+
+/*
+once per second, by whoever comes first
+over the budget: sites above their share are sampled down, twice as much
+under the half of the budget: all sites are sampled up, twice as much
+*/
+static void sample_adapt_(long long elapsed_ms)
+{
+	const long long total_ = InterlockedExchange64(&SAMPLE.window_bytes, 0);
+	const long long budget_ = (long long)SAMPLE.budget * elapsed_ms / 1000;
+
+	long long active_ = 0;
+	for (int j = 0; j < DBJ_LOG_SAMPLE_SITES; ++j)
+		if (SAMPLE.sites[j].at.line > 0 && SAMPLE.sites[j].window_bytes > 0) ++active_;
+
+	const long long share_ = budget_ / (active_ ? active_ : 1);
+
+	for (int j = 0; j < DBJ_LOG_SAMPLE_SITES; ++j)
+	{
+		sample_site_* site = SAMPLE.sites + j;
+		if (site->at.line <= 0) continue;
+
+		const long long bytes_ = InterlockedExchange64(&site->window_bytes, 0);
+		const LONG adaptive_ = site->adaptive;
+
+		if (total_ > budget_ && bytes_ > share_ && adaptive_ < sample_adaptive_max_)
+			InterlockedExchange(&site->adaptive, adaptive_ * 2);
+		else if (total_ < budget_ / 2 && adaptive_ > 1)
+			InterlockedExchange(&site->adaptive, adaptive_ / 2);
+	}
+}
+
+static void sample_account_(sample_site_* site, size_t bytes)
+{
+	if (SAMPLE.budget <= 0) return;
+
+	if (site) InterlockedExchangeAdd64(&site->window_bytes, (LONG64)bytes);
+	InterlockedExchangeAdd64(&SAMPLE.window_bytes, (LONG64)bytes);
+
+	const LONG64 now_ = (LONG64)GetTickCount64();
+	const LONG64 start_ = SAMPLE.window_start;
+	if (now_ - start_ < 1000) return;
+	if (InterlockedCompareExchange64(&SAMPLE.window_start, now_, start_) != start_) return;
+
+	/* the very first window is just started */
+	if (start_) sample_adapt_(now_ - start_);
+}
+
+void dbj_log_sample_level(int level, unsigned one_in)
+{
+	DBJ_ASSERT(level >= DBJ_LOG_TRACE && level <= DBJ_LOG_FATAL);
+	if (level < DBJ_LOG_TRACE || level > DBJ_LOG_FATAL) return;
+
+	InterlockedExchange(&SAMPLE.level_one_in[level], (LONG)(one_in > LONG_MAX ? LONG_MAX : one_in));
+	sample_on_update_();
+}
+
+void dbj_log_sample_site(const char* file, int line, unsigned one_in)
+{
+	DBJ_ASSERT(file && line > 0);
+	sample_site_* site = file ? sample_site_find_(file, line, true) : NULL;
+	if (!site) return;
+
+	const LONG before_ = InterlockedExchange(&site->one_in, (LONG)(one_in > LONG_MAX ? LONG_MAX : one_in));
+	if (!before_ && one_in) InterlockedIncrement(&SAMPLE.sites_set);
+	if (before_ && !one_in) InterlockedDecrement(&SAMPLE.sites_set);
+	sample_on_update_();
+}
+
+void dbj_log_sample_budget(unsigned bytes_per_second)
+{
+	InterlockedExchange(&SAMPLE.budget, (LONG)(bytes_per_second > LONG_MAX ? LONG_MAX : bytes_per_second));
+
+	if (!bytes_per_second) {
+		/* back to the fixed rates */
+		for (int j = 0; j < DBJ_LOG_SAMPLE_SITES; ++j)
+			if (SAMPLE.sites[j].at.line > 0) InterlockedExchange(&SAMPLE.sites[j].adaptive, 1);
+	}
+	sample_on_update_();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// backpressure
+///
+/// latency of writing the line, under the lock, and the number of threads
+/// waiting for the lock are watched
+/// over the limit: effective level is raised, one level at the time, up to WARN
+/// well under the limit, for long enough: lowered, back to the configured one
+/// each change is told with one WARN line
+/// while degraded, a probe line is let through now and then, to see the recovery
+/// DBJ_LOG_DEGRADE_LATENCY_US 0, the default, compiles it all out of the logging path
+
+static struct {
+	/* lines below are not logged, DBJ_LOG_TRACE is not degraded */
+	volatile LONG floor;
+	volatile LONG waiting;
+	/* QPC ticks */
+	long long freq;
+	long long ewma;
+	long long changed_at;
+	volatile LONG64 probe_at;
+} DEGRADE;
+
+#if DBJ_LOG_DEGRADE_LATENCY_US
+static void degrade_freq_(void)
+{
+	if (DEGRADE.freq) return;
+	LARGE_INTEGER freq_;
+	QueryPerformanceFrequency(&freq_);
+	DEGRADE.freq = freq_.QuadPart;
+}
+
+/* true if the line below the floor is to be let through as a probe */
+static bool degrade_probe_(void)
+{
+	degrade_freq_();
+	LARGE_INTEGER now_;
+	QueryPerformanceCounter(&now_);
+
+	const LONG64 last_ = DEGRADE.probe_at;
+	if (now_.QuadPart - last_ < DEGRADE.freq * DBJ_LOG_DEGRADE_HOLD_MS / 4000) return false;
+	return InterlockedCompareExchange64(&DEGRADE.probe_at, now_.QuadPart, last_) == last_;
+}
+
+/*
+under the lock, after the line was written
+returns true if the floor was changed
+*/
+static bool degrade_note_(long long start, long long end, long waiting)
+{
+	degrade_freq_();
+	DEGRADE.ewma += (end - start - DEGRADE.ewma) / 8;
+
+	const long long limit_ = DEGRADE.freq * DBJ_LOG_DEGRADE_LATENCY_US / 1000000;
+	const long long since_ = end - DEGRADE.changed_at;
+	LONG floor_ = DEGRADE.floor;
+
+	if ((DEGRADE.ewma > limit_ || waiting > DBJ_LOG_DEGRADE_BACKLOG)
+		&& since_ > DEGRADE.freq / 4
+		&& floor_ < DBJ_LOG_WARN && LOCAL.level < DBJ_LOG_WARN)
+	{
+		floor_ = (floor_ > LOCAL.level ? floor_ : LOCAL.level) + 1;
+	}
+	else if (floor_ > DBJ_LOG_TRACE
+		&& DEGRADE.ewma < limit_ / 4 && waiting <= DBJ_LOG_DEGRADE_BACKLOG / 4
+		&& since_ > DEGRADE.freq * DBJ_LOG_DEGRADE_HOLD_MS / 1000)
+	{
+		floor_ -= 1;
+		if (floor_ <= LOCAL.level) floor_ = DBJ_LOG_TRACE;
+	}
+	else {
+		return false;
+	}
+
+	InterlockedExchange(&DEGRADE.floor, floor_);
+	DEGRADE.changed_at = end;
+	return true;
+}
+#endif // DBJ_LOG_DEGRADE_LATENCY_US
+
+////////////////////////////////////////////////////////////////////////////////
+/// per thread diagnostic context
+///
+/// thread name and key=value pairs, pushed and popped by the thread itself
+/// rendered into the fragment only when they change
+/// log line just copies the fragment, after the prefix
+/// [<thread id>:<thread name> key=value key=value] 
+
+#define dbj_log_ctx_key_len 16
+#define dbj_log_ctx_value_len 48
+
+static __declspec(thread) struct {
+	char name[32];
+	/* can be deeper than DBJ_LOG_CTX_MAX, only that many are shown */
+	int depth;
+	struct {
+		char key[dbj_log_ctx_key_len];
+		char value[dbj_log_ctx_value_len];
+	} entries[DBJ_LOG_CTX_MAX];
+	char fragment[64 + DBJ_LOG_CTX_MAX * (dbj_log_ctx_key_len + dbj_log_ctx_value_len + 2)];
+	size_t fragment_len;
+} log_ctx_tls_;
+
+static void log_ctx_render_(void)
+{
+	if (log_ctx_tls_.depth == 0 && log_ctx_tls_.name[0] == '\0') {
+		log_ctx_tls_.fragment[0] = '\0';
+		log_ctx_tls_.fragment_len = 0;
+		return;
+	}
+
+	char digits[12];
+	const int n = u64_to_dec_(GetCurrentThreadId(), digits + sizeof(digits));
+	/* room for the "] " is always left */
+	fmt_out_ out = { log_ctx_tls_.fragment, log_ctx_tls_.fragment + sizeof(log_ctx_tls_.fragment) - 3, false };
+
+	fmt_put_(&out, "[", 1);
+	fmt_put_(&out, digits + sizeof(digits) - n, (size_t)n);
+	if (log_ctx_tls_.name[0]) {
+		fmt_put_(&out, ":", 1);
+		fmt_put_(&out, log_ctx_tls_.name, strlen(log_ctx_tls_.name));
+	}
+
+	const int shown_ = log_ctx_tls_.depth < DBJ_LOG_CTX_MAX ? log_ctx_tls_.depth : DBJ_LOG_CTX_MAX;
+	for (int j = 0; j < shown_; ++j) {
+		fmt_put_(&out, " ", 1);
+		fmt_put_(&out, log_ctx_tls_.entries[j].key, strlen(log_ctx_tls_.entries[j].key));
+		fmt_put_(&out, "=", 1);
+		fmt_put_(&out, log_ctx_tls_.entries[j].value, strlen(log_ctx_tls_.entries[j].value));
+	}
+
+	memcpy(out.p, "] ", 3);
+	log_ctx_tls_.fragment_len = (size_t)(out.p + 2 - log_ctx_tls_.fragment);
+}
+
+void dbj_log_ctx_push(const char* key, const char* value)
+{
+	DBJ_ASSERT(key && value);
+
+	if (log_ctx_tls_.depth < DBJ_LOG_CTX_MAX) {
+		strncpy_s(log_ctx_tls_.entries[log_ctx_tls_.depth].key, dbj_log_ctx_key_len, key, _TRUNCATE);
+		strncpy_s(log_ctx_tls_.entries[log_ctx_tls_.depth].value, dbj_log_ctx_value_len, value, _TRUNCATE);
+	}
+	log_ctx_tls_.depth += 1;
+	log_ctx_render_();
+}
+
+void dbj_log_ctx_pop(void)
+{
+	DBJ_ASSERT(log_ctx_tls_.depth > 0);
+	if (log_ctx_tls_.depth == 0) return;
+
+	log_ctx_tls_.depth -= 1;
+	log_ctx_render_();
+}
+
+void dbj_log_thread_name(const char* name)
+{
+	strncpy_s(log_ctx_tls_.name, sizeof(log_ctx_tls_.name), name ? name : "", _TRUNCATE);
+	log_ctx_render_();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// shared memory ring, DBJ_LOG_SHARED_RING
+///
+/// many processes of the same binary, one log file
+/// each process writes its lines into the ring living in the named file mapping
+/// slots are reserved lock free, across processes, in one global order
+/// one collector, elected by the named mutex, drains the ring into the file
+/// collector is a thread in one of the workers or the dbj_log_collector tool
+
+/* must be a power of 2 */
+#ifndef DBJ_LOG_RING_SLOTS
+#define DBJ_LOG_RING_SLOTS 4096
+#endif
+
+/* longer lines are truncated, they end with "...", and counted */
+#ifndef DBJ_LOG_RING_SLOT_SIZE
+#define DBJ_LOG_RING_SLOT_SIZE 512
+#endif
+
+#define dbj_log_ring_magic 0x474E4952 /* "RING" */
+
+/* producer gives up after this many tries on the full ring */
+#define dbj_log_ring_full_spins 64
+
+/* claimed but not published for this long, the writer is asked if it is dead */
+#define dbj_log_ring_stall_ms 1000
+
+/*
+slot sequence, for the lap of the position pos
+	pos              free for this lap
+	ring_writing_    claimed by the writer thread, this lap, being written
+	pos + 1          published, for the collector to drain
+	pos + slots      drained or given up, free for the next lap
+the slot is claimed first, with the writer thread id in the sequence, then
+the head is moved, any producer finding the claimed slot at the head moves it
+there is no slot reserved by nobody known, the collector always knows whom to ask
+*/
+#define ring_writing_(POS_, TID_) (LLONG_MIN | ((LONG64)((POS_) & 0x7FFFFFFF) << 32) | (LONG64)(DWORD)(TID_))
+#define ring_writer_of_(SEQ_) ((DWORD)((SEQ_) & 0xFFFFFFFF))
+
+typedef struct ring_slot_ {
+	LONG64 volatile sequence;
+	UINT32 length;
+	/* writer, after the claim, valid when owner_pos is the slot position */
+	UINT32 owner_pid;
+	LONG64 volatile owner_pos;
+	/* FILETIME of the writer thread creation, thread ids are reused */
+	ULONGLONG owner_started;
+	char bytes[DBJ_LOG_RING_SLOT_SIZE - 32];
+} ring_slot_;
+
+typedef struct ring_shared_ {
+	UINT32 magic;
+	UINT32 slot_count;
+	LONG volatile ready;
+	LONG volatile file_made;
+	LONG64 volatile head;
+	LONG64 volatile tail;
+	LONG64 volatile dropped;
+	LONG64 volatile truncated;
+	ring_slot_ slots[DBJ_LOG_RING_SLOTS];
+} ring_shared_;
+
+static struct {
+	HANDLE mapping;
+	HANDLE collector_mutex;
+	HANDLE stop;
+	HANDLE collector_thread;
+	ring_shared_* shared;
+	char file_name[dbj_fhandle_max_name_len];
+} RING = { 0 };
+
+/* kernel object names can not have backslashes, log file name is hashed */
+static void ring_object_name_(char* buf, size_t size, const char* file_name, const char* what)
+{
+	unsigned long long hash = 14695981039346656037ULL;
+	for (const char* p = file_name; *p; ++p) {
+		hash ^= (unsigned char)(*p >= 'A' && *p <= 'Z' ? *p - 'A' + 'a' : *p);
+		hash *= 1099511628211ULL;
+	}
+	int rez = _snprintf_s(buf, size, _TRUNCATE, "Local\\dbj_simplelog_%016llx_%s", hash, what);
+	DBJ_ASSERT(rez > 0);
+}
+
+static bool ring_open_(const char* file_name)
+{
+	if (RING.shared) return true;
+
+	char name_[128];
+	errno_t rez = strncpy_s(RING.file_name, sizeof(RING.file_name), file_name, sizeof(RING.file_name) - 1);
+	DBJ_ASSERT(rez == 0);
+
+	ring_object_name_(name_, sizeof(name_), file_name, "ring");
+	const unsigned long long size_ = sizeof(ring_shared_);
+	RING.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+		(DWORD)(size_ >> 32), (DWORD)(size_ & 0xFFFFFFFF), name_);
+	if (!RING.mapping) return false;
+
+	const bool creator_ = GetLastError() != ERROR_ALREADY_EXISTS;
+
+	ring_shared_* shared = (ring_shared_*)MapViewOfFile(RING.mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(ring_shared_));
+	if (!shared) {
+		CloseHandle(RING.mapping);
+		RING.mapping = NULL;
+		return false;
+	}
+
+	if (creator_) {
+		/* mapping is zeroed by the OS */
+		shared->magic = dbj_log_ring_magic;
+		shared->slot_count = DBJ_LOG_RING_SLOTS;
+		for (LONG64 j = 0; j < DBJ_LOG_RING_SLOTS; ++j) {
+			shared->slots[j].sequence = j;
+			shared->slots[j].owner_pos = -1;
+		}
+		InterlockedExchange(&shared->ready, 1);
+	}
+	else {
+		for (int spin = 0; shared->ready == 0 && spin < 1000; ++spin) Sleep(1);
+	}
+
+	if (shared->ready == 0 || shared->magic != dbj_log_ring_magic || shared->slot_count != DBJ_LOG_RING_SLOTS) {
+		// not the same binary?
+		UnmapViewOfFile(shared);
+		CloseHandle(RING.mapping);
+		RING.mapping = NULL;
+		return false;
+	}
+
+	ring_object_name_(name_, sizeof(name_), file_name, "collector");
+	RING.collector_mutex = CreateMutexA(NULL, FALSE, name_);
+	RING.stop = CreateEventA(NULL, TRUE, FALSE, NULL);
+	RING.shared = shared;
+	return true;
+}
+
+/* creation time of this thread, once per thread */
+static ULONGLONG ring_thread_started_(void)
+{
+	static __declspec(thread) ULONGLONG started_;
+	if (!started_) {
+		FILETIME created_, exited_, kernel_, user_;
+		if (GetThreadTimes(GetCurrentThread(), &created_, &exited_, &kernel_, &user_))
+			started_ = ((ULONGLONG)created_.dwHighDateTime << 32) | created_.dwLowDateTime;
+	}
+	return started_;
+}
+
+/* called by producers, in any process, never blocks for long */
+static bool ring_write_(const char* bytes, size_t len)
+{
+	ring_shared_* ring = RING.shared;
+	const LONG64 mask = DBJ_LOG_RING_SLOTS - 1;
+	const DWORD tid_ = GetCurrentThreadId();
+	const ULONGLONG started_ = ring_thread_started_();
+	ring_slot_* slot = NULL;
+	LONG64 pos = 0;
+
+	for (int spin = 0; ; ) {
+		pos = ring->head;
+		slot = &ring->slots[pos & mask];
+		const LONG64 seq = slot->sequence;
+
+		if (seq == pos) {
+			/* claimed, then the head is moved, by us or by the next producer */
+			if (InterlockedCompareExchange64(&slot->sequence, ring_writing_(pos, tid_), pos) == pos) {
+				InterlockedCompareExchange64(&ring->head, pos + 1, pos);
+				break;
+			}
+		}
+		else if (seq == pos + 1 || (seq < 0 && (seq & ~0xFFFFFFFFLL) == (ring_writing_(pos, 0)))) {
+			/* claimed this lap, its writer has not moved the head yet */
+			InterlockedCompareExchange64(&ring->head, pos + 1, pos);
+		}
+		else if (++spin > dbj_log_ring_full_spins) {
+			/* full, slot of the last lap, collector is late or gone */
+			InterlockedIncrement64(&ring->dropped);
+			return false;
+		}
+		else {
+			YieldProcessor();
+		}
+	}
+
+	/* who to ask if we are alive, if this takes long */
+	slot->owner_pid = GetCurrentProcessId();
+	slot->owner_started = started_;
+	InterlockedExchange64(&slot->owner_pos, pos);
+
+	if (len > sizeof(slot->bytes)) {
+		/* marked, as the line is cut */
+		static const char cut_[] = "...\n";
+		InterlockedIncrement64(&ring->truncated);
+		len = sizeof(slot->bytes);
+		memcpy(slot->bytes, bytes, len - (sizeof(cut_) - 1));
+		memcpy(slot->bytes + len - (sizeof(cut_) - 1), cut_, sizeof(cut_) - 1);
+	}
+	else {
+		memcpy(slot->bytes, bytes, len);
+	}
+	slot->length = (UINT32)len;
+
+	/* claimed slot is given up only when this thread is confirmed dead */
+	InterlockedExchange64(&slot->sequence, pos + 1);
+	return true;
+}
+
+/* 1 alive, 0 dead, -1 can not tell */
+static int ring_handle_alive_(HANDLE h, bool thread, ULONGLONG started)
+{
+	DWORD code_ = 0;
+	const bool got_ = thread ? GetExitCodeThread(h, &code_) : GetExitCodeProcess(h, &code_);
+	int alive_ = got_ ? (code_ == STILL_ACTIVE) : -1;
+
+	/* the same id, some other thread */
+	if (alive_ == 1 && thread && started) {
+		FILETIME created_, exited_, kernel_, user_;
+		if (GetThreadTimes(h, &created_, &exited_, &kernel_, &user_)
+			&& started != (((ULONGLONG)created_.dwHighDateTime << 32) | created_.dwLowDateTime))
+			alive_ = 0;
+	}
+	CloseHandle(h);
+	return alive_;
+}
+
+/*
+false only if the writer of the slot claimed at pos is confirmed dead,
+it might be in some other process
+the thread is asked first, its creation time tells the reused id,
+the process when the thread can not be opened
+*/
+static bool ring_writer_alive_(const ring_slot_* slot, LONG64 seq, LONG64 pos)
+{
+	const bool owner_ = slot->owner_pos == pos;
+	const ULONGLONG started_ = owner_ ? slot->owner_started : 0;
+
+	HANDLE thread_ = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, ring_writer_of_(seq));
+	if (thread_) return ring_handle_alive_(thread_, true, started_) != 0;
+	if (GetLastError() == ERROR_INVALID_PARAMETER) return false;
+
+	/* not allowed to see the thread, its process then */
+	if (!owner_) return true;
+	HANDLE process_ = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, slot->owner_pid);
+	if (process_) return ring_handle_alive_(process_, false, 0) != 0;
+	return GetLastError() != ERROR_INVALID_PARAMETER;
+}
+
+/* single consumer, only the collector holding the mutex calls this */
+static size_t ring_drain_(FILE* fp, ULONGLONG* stall_since)
+{
+	ring_shared_* ring = RING.shared;
+	const LONG64 mask = DBJ_LOG_RING_SLOTS - 1;
+	size_t drained = 0;
+
+	for (;;)
+	{
+		const LONG64 pos = ring->tail;
+		if (pos == ring->head) break;
+
+		ring_slot_* slot = &ring->slots[pos & mask];
+
+		const LONG64 seq = slot->sequence;
+		if (seq != pos + 1) {
+			/* being written, not yet published, head is past it thus it is claimed */
+			if (*stall_since == 0) *stall_since = GetTickCount64();
+			if (GetTickCount64() - *stall_since < dbj_log_ring_stall_ms) break;
+			/* slow writer, or the one we can not ask, the slot stays its own */
+			if (seq >= 0 || ring_writer_alive_(slot, seq, pos)) break;
+			/* writer died, skip it */
+			if (InterlockedCompareExchange64(&slot->sequence, pos + DBJ_LOG_RING_SLOTS, seq) == seq) {
+				InterlockedIncrement64(&ring->dropped);
+				InterlockedExchange64(&ring->tail, pos + 1);
+				*stall_since = 0;
+				continue;
+			}
+			/* published just now */
+		}
+
+		*stall_since = 0;
+		fwrite(slot->bytes, 1, slot->length, fp);
+		++drained;
+
+		InterlockedExchange64(&slot->sequence, pos + DBJ_LOG_RING_SLOTS);
+		InterlockedExchange64(&ring->tail, pos + 1);
+	}
+
+	if (drained) {
+		DBJ_FERROR(fp);
+		fflush(fp);
+	}
+	return drained;
+}
+
+/* wait to be elected, then collect until stopped */
+static int ring_collect_(void)
+{
+	HANDLE wait_for_[2] = { RING.stop, RING.collector_mutex };
+	const DWORD rez = WaitForMultipleObjects(2, wait_for_, FALSE, INFINITE);
+
+	/* stopped before being elected */
+	if (rez == WAIT_OBJECT_0) return EXIT_SUCCESS;
+	/* WAIT_ABANDONED + 1 is the previous collector dying, we take over */
+	if (rez != WAIT_OBJECT_0 + 1 && rez != WAIT_ABANDONED + 1) return EXIT_FAILURE;
+
+	/* the first collector ever makes the file, the ones taking over append */
+	const bool first_ = 0 == InterlockedCompareExchange(&RING.shared->file_made, 1, 0);
+	FILE* fp = _fsopen(RING.file_name, first_ ? "wc" : "ac", _SH_DENYWR);
+
+	if (!fp) {
+		DBJ_PERROR;
+		InterlockedExchange(&RING.shared->file_made, 0);
+		ReleaseMutex(RING.collector_mutex);
+		return EXIT_FAILURE;
+	}
+
+	ULONGLONG stall_since = 0;
+	while (WaitForSingleObject(RING.stop, 0) == WAIT_TIMEOUT) {
+		if (0 == ring_drain_(fp, &stall_since))
+			Sleep(1);
+	}
+	/* whatever is left */
+	(void)ring_drain_(fp, &stall_since);
+
+	fclose(fp);
+	ReleaseMutex(RING.collector_mutex);
+	return EXIT_SUCCESS;
+}
+
+static DWORD WINAPI ring_collector_thread_(LPVOID param_)
+{
+	(void)param_;
+	return (DWORD)ring_collect_();
+}
+
+/* producer side, the elected worker is collecting too */
+static bool ring_worker_start_(const char* file_name)
+{
+	if (!ring_open_(file_name)) return false;
+	RING.collector_thread = CreateThread(NULL, 0, ring_collector_thread_, NULL, 0, NULL);
+	return RING.collector_thread != NULL;
+}
+
+static void ring_close_(void)
+{
+	if (!RING.shared) return;
+
+	SetEvent(RING.stop);
+	if (RING.collector_thread) {
+		/* still collecting, process is going down anyway, leave it all to the OS */
+		if (WAIT_OBJECT_0 != WaitForSingleObject(RING.collector_thread, 5000)) return;
+		CloseHandle(RING.collector_thread);
+		RING.collector_thread = NULL;
+	}
+	UnmapViewOfFile(RING.shared);
+	RING.shared = NULL;
+	CloseHandle(RING.mapping);
+	CloseHandle(RING.collector_mutex);
+	CloseHandle(RING.stop);
+}
+
+int dbj_log_ring_collector_run(const char* app_full_path)
+{
+	DBJ_ASSERT(app_full_path);
+	dbj_fhandle fh = dbj_fhandle_make(app_full_path);
+
+	if (!ring_open_(fh.name)) return EXIT_FAILURE;
+	return ring_collect_();
+}
+
+void dbj_log_ring_collector_stop(void)
+{
+	if (RING.stop) SetEvent(RING.stop);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// sparse side index, DBJ_LOG_FILE_INDEX
+///
+/// every file line is only counted here
+/// index entry is written once per block of lines
+
+static struct {
+	FILE* fp;
+	/* bytes written to the log file so far */
+	unsigned long long offset;
+	dbj_log_index_entry block;
+} INDEX = { 0 };
+
+static void index_open_(const char* log_file_name)
+{
+	char name_[dbj_fhandle_max_name_len + 8];
+	int rez = _snprintf_s(name_, sizeof(name_), _TRUNCATE, "%s.idx", log_file_name);
+	DBJ_ASSERT(rez > 0);
+
+	INDEX.fp = _fsopen(name_, "wbc", _SH_DENYWR);
+	if (!INDEX.fp) {
+		DBJ_PERROR;
+		return;
+	}
+
+	const dbj_log_index_header header_ = { DBJ_LOG_INDEX_MAGIC, sizeof(dbj_log_index_entry) };
+	fwrite(&header_, sizeof(header_), 1, INDEX.fp);
+	fflush(INDEX.fp);
+}
+
+static void index_block_commit_(void)
+{
+	if (INDEX.block.lines == 0) return;
+
+	fwrite(&INDEX.block, sizeof(INDEX.block), 1, INDEX.fp);
+	DBJ_FERROR(INDEX.fp);
+	fflush(INDEX.fp);
+
+	memset(&INDEX.block, 0, sizeof(INDEX.block));
+}
+
+/* called after each write to the log file, of that many lines */
+static void index_note_(time_t when, int level, size_t lines, size_t len)
+{
+	if (!INDEX.fp) return;
+
+	if (INDEX.block.lines == 0) {
+		INDEX.block.offset = INDEX.offset;
+		INDEX.block.first_time = (long long)when;
+	}
+	INDEX.block.last_time = (long long)when;
+	INDEX.block.level_bits |= 1u << level;
+	INDEX.block.lines += (unsigned)lines;
+
+	INDEX.block.bytes += len;
+	INDEX.offset += len;
+
+	if (INDEX.block.lines >= DBJ_LOG_INDEX_LINES || INDEX.block.bytes >= DBJ_LOG_INDEX_BYTES)
+		index_block_commit_();
+}
+
+static void index_close_(void)
+{
+	if (!INDEX.fp) return;
+	index_block_commit_();
+	fclose(INDEX.fp);
+	INDEX.fp = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// CRC32C of the log file records, DBJ_LOG_CRC
+///
+/// SSE4.2 crc32 instruction, 8 bytes at once, if the CPU has it
+/// otherwise slicing by 8, tables are made once
+/// records are short, one stream is enough, no interleaving
+
+static struct {
+	INIT_ONCE once;
+	bool hardware;
+	unsigned table[8][256];
+} CRC = { INIT_ONCE_STATIC_INIT };
+
+static BOOL CALLBACK crc_make_(INIT_ONCE* once_, PVOID param_, PVOID* context_)
+{
+	(void)once_; (void)param_; (void)context_;
+
+	/* reflected Castagnoli polynomial */
+	for (unsigned n = 0; n < 256; ++n) {
+		unsigned crc = n;
+		for (int k = 0; k < 8; ++k)
+			crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+		CRC.table[0][n] = crc;
+	}
+	for (unsigned n = 0; n < 256; ++n)
+		for (int k = 1; k < 8; ++k)
+			CRC.table[k][n] = (CRC.table[k - 1][n] >> 8) ^ CRC.table[0][CRC.table[k - 1][n] & 0xFF];
+
+#ifdef DBJ_LOG_CRC_HW
+	int regs_[4] = { 0 };
+	__cpuid(regs_, 1);
+	CRC.hardware = 0 != (regs_[2] & (1 << 20));
+#endif // DBJ_LOG_CRC_HW
+	return TRUE;
+}
+
+static unsigned crc32c_table_(unsigned crc, const unsigned char* p, size_t n)
+{
+	while (n && ((uintptr_t)p & 7)) {
+		crc = CRC.table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+		--n;
+	}
+	while (n >= 8) {
+		unsigned lo_, hi_;
+		memcpy(&lo_, p, 4);
+		memcpy(&hi_, p + 4, 4);
+		lo_ ^= crc;
+		crc = CRC.table[7][lo_ & 0xFF] ^ CRC.table[6][(lo_ >> 8) & 0xFF]
+			^ CRC.table[5][(lo_ >> 16) & 0xFF] ^ CRC.table[4][lo_ >> 24]
+			^ CRC.table[3][hi_ & 0xFF] ^ CRC.table[2][(hi_ >> 8) & 0xFF]
+			^ CRC.table[1][(hi_ >> 16) & 0xFF] ^ CRC.table[0][hi_ >> 24];
+		p += 8;
+		n -= 8;
+	}
+	while (n--)
+		crc = CRC.table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+	return crc;
+}
+
+#ifdef DBJ_LOG_CRC_HW
+__attribute__((target("sse4.2")))
+static unsigned crc32c_sse42_(unsigned crc, const unsigned char* p, size_t n)
+{
+	while (n && ((uintptr_t)p & 7)) {
+		crc = _mm_crc32_u8(crc, *p++);
+		--n;
+	}
+	unsigned long long crc64_ = crc;
+	while (n >= 8) {
+		unsigned long long v_;
+		memcpy(&v_, p, 8);
+		crc64_ = _mm_crc32_u64(crc64_, v_);
+		p += 8;
+		n -= 8;
+	}
+	crc = (unsigned)crc64_;
+	while (n--)
+		crc = _mm_crc32_u8(crc, *p++);
+	return crc;
+}
+#endif // DBJ_LOG_CRC_HW
+
+unsigned dbj_log_crc32c(unsigned crc, const void* data, size_t len)
+{
+	InitOnceExecuteOnce(&CRC.once, crc_make_, NULL, NULL);
+	const unsigned char* p = (const unsigned char*)data;
+#ifdef DBJ_LOG_CRC_HW
+	if (CRC.hardware) return ~crc32c_sse42_(~crc, p, len);
+#endif // DBJ_LOG_CRC_HW
+	return ~crc32c_table_(~crc, p, len);
+}
+
+/* length is in the crc too, torn length is not taken as the good one */
+static dbj_log_crc_header crc_header_(const char* text, size_t len)
+{
+	dbj_log_crc_header header_ = { DBJ_LOG_CRC_MAGIC, (unsigned)len, 0 };
+	header_.crc = dbj_log_crc32c(dbj_log_crc32c(0, &header_.length, sizeof(header_.length)), text, len);
+	return header_;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// compressed log file, DBJ_LOG_COMPRESS
+///
+/// lines are appended to the current block, under the guard, that is all
+/// full blocks are compressed and written by the worker thread, as frames
+/// each frame is independent: dbj_log_frame_header then LZ4 block, or raw bytes
+/// at the end the seek table is written, see dbj_log_seek_trailer
+/// there is no seek table after the crash, frames can still be walked
+/// not full block is also written after DBJ_LOG_COMPRESS_FLUSH_MS
+/// the worker never takes the log lock, it is the one giving the blocks back
+
+#define compress_hash_bits_ 12
+
+static struct {
+	FILE* fp;
+	HANDLE worker;
+	SRWLOCK guard;
+	/* sealed block or stop */
+	CONDITION_VARIABLE work;
+	/* free block */
+	CONDITION_VARIABLE room;
+	bool stop;
+	char* free_blocks[DBJ_LOG_COMPRESS_BLOCKS];
+	int free_count;
+	struct {
+		char* data;
+		size_t len;
+	} sealed[DBJ_LOG_COMPRESS_BLOCKS];
+	int sealed_first;
+	int sealed_count;
+	/* NULL while the seal waits for the free block */
+	char* current;
+	size_t fill;
+	/* worker only */
+	unsigned char* out;
+	size_t out_cap;
+	unsigned table[1 << compress_hash_bits_];
+	unsigned long long offset;
+	unsigned long long raw_offset;
+	dbj_log_seek_entry* seek;
+	size_t seek_count;
+	size_t seek_cap;
+} COMPRESS;
+
+static unsigned lz4_read32_(const unsigned char* p)
+{
+	unsigned v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static unsigned char* lz4_length_(unsigned char* op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (unsigned char)len;
+	return op;
+}
+
+static unsigned char* lz4_sequence_(unsigned char* op, const unsigned char* literals, size_t literal_len,
+	size_t offset, size_t match_len)
+{
+	unsigned char* token = op++;
+	*token = (unsigned char)((literal_len < 15 ? literal_len : 15) << 4);
+	if (literal_len >= 15) op = lz4_length_(op, literal_len - 15);
+	memcpy(op, literals, literal_len);
+	op += literal_len;
+
+	/* the last sequence has no match */
+	if (!match_len) return op;
+
+	*op++ = (unsigned char)(offset & 0xFF);
+	*op++ = (unsigned char)(offset >> 8);
+	match_len -= 4;
+	*token |= (unsigned char)(match_len < 15 ? match_len : 15);
+	if (match_len >= 15) op = lz4_length_(op, match_len - 15);
+	return op;
+}
+
+/* LZ4 worst case */
+#define lz4_bound_(n) ((n) + (n) / 255 + 16)
+
+/*
+LZ4 block format, greedy, one probe per position, fast enough for logs
+dst must have lz4_bound_(n) bytes, returns the compressed length
+*/
+static size_t lz4_compress_(const unsigned char* src, size_t n, unsigned char* dst, unsigned* table)
+{
+	const unsigned char* ip = src;
+	const unsigned char* anchor = src;
+	const unsigned char* const end = src + n;
+	unsigned char* op = dst;
+
+	/* format rules: last match starts 12 bytes before the end, last 5 bytes are literals */
+	if (n > 12) {
+		const unsigned char* const match_start_limit = end - 12;
+		const unsigned char* const match_end_limit = end - 5;
+
+		memset(table, 0xFF, sizeof(unsigned) << compress_hash_bits_);
+
+		while (ip < match_start_limit)
+		{
+			const unsigned seq = lz4_read32_(ip);
+			const unsigned h = (seq * 2654435761u) >> (32 - compress_hash_bits_);
+			const unsigned at = table[h];
+			table[h] = (unsigned)(ip - src);
+
+			if (at == 0xFFFFFFFFu || (size_t)(ip - src) - at > 65535 || lz4_read32_(src + at) != seq) {
+				++ip;
+				continue;
+			}
+
+			const unsigned char* ref = src + at + 4;
+			const unsigned char* m = ip + 4;
+			while (m < match_end_limit && *m == *ref) {
+				++m;
+				++ref;
+			}
+
+			op = lz4_sequence_(op, anchor, (size_t)(ip - anchor), (size_t)(ip - (src + at)), (size_t)(m - ip));
+			ip = anchor = m;
+		}
+	}
+
+	op = lz4_sequence_(op, anchor, (size_t)(end - anchor), 0, 0);
+	return (size_t)(op - dst);
+}
+
+/* worker only */
+static void compress_frame_write_(const char* raw, size_t len)
+{
+	const size_t packed_ = lz4_compress_((const unsigned char*)raw, len, COMPRESS.out, COMPRESS.table);
+	const bool stored_ = packed_ >= len;
+
+	dbj_log_frame_header header_ = {
+		DBJ_LOG_FRAME_MAGIC,
+		(unsigned)(stored_ ? len : packed_),
+		(unsigned)len,
+		stored_ ? DBJ_LOG_FRAME_RAW : 0u
+	};
+
+	fwrite(&header_, sizeof(header_), 1, COMPRESS.fp);
+	fwrite(stored_ ? (const void*)raw : (const void*)COMPRESS.out, 1, header_.stored_size, COMPRESS.fp);
+	fflush(COMPRESS.fp);
+	DBJ_FERROR(COMPRESS.fp);
+
+	if (COMPRESS.seek_count == COMPRESS.seek_cap) {
+		const size_t cap_ = COMPRESS.seek_cap ? COMPRESS.seek_cap * 2 : 256;
+		dbj_log_seek_entry* seek_ = (dbj_log_seek_entry*)realloc(COMPRESS.seek, cap_ * sizeof(dbj_log_seek_entry));
+		if (seek_) {
+			COMPRESS.seek = seek_;
+			COMPRESS.seek_cap = cap_;
+		}
+	}
+	if (COMPRESS.seek_count < COMPRESS.seek_cap) {
+		COMPRESS.seek[COMPRESS.seek_count].offset = COMPRESS.offset;
+		COMPRESS.seek[COMPRESS.seek_count].raw_offset = COMPRESS.raw_offset;
+		COMPRESS.seek_count += 1;
+	}
+	COMPRESS.offset += sizeof(header_) + header_.stored_size;
+	COMPRESS.raw_offset += len;
+}
+
+/* under the guard, waits if the worker is behind */
+static void compress_seal_(void)
+{
+	if (!COMPRESS.fill) return;
+
+	const int slot_ = (COMPRESS.sealed_first + COMPRESS.sealed_count) % DBJ_LOG_COMPRESS_BLOCKS;
+	COMPRESS.sealed[slot_].data = COMPRESS.current;
+	COMPRESS.sealed[slot_].len = COMPRESS.fill;
+	COMPRESS.sealed_count += 1;
+	COMPRESS.current = NULL;
+	COMPRESS.fill = 0;
+	WakeConditionVariable(&COMPRESS.work);
+
+	while (COMPRESS.free_count == 0)
+		SleepConditionVariableSRW(&COMPRESS.room, &COMPRESS.guard, INFINITE, 0);
+	COMPRESS.current = COMPRESS.free_blocks[--COMPRESS.free_count];
+}
+
+/* under the log lock too, lines do not straddle the blocks, unless longer than one */
+static void compress_append_(const char* data, size_t len)
+{
+	AcquireSRWLockExclusive(&COMPRESS.guard);
+	if (COMPRESS.fill + len > DBJ_LOG_COMPRESS_BLOCK) compress_seal_();
+
+	while (len) {
+		const size_t chunk_ = len < DBJ_LOG_COMPRESS_BLOCK - COMPRESS.fill ? len : DBJ_LOG_COMPRESS_BLOCK - COMPRESS.fill;
+		memcpy(COMPRESS.current + COMPRESS.fill, data, chunk_);
+		COMPRESS.fill += chunk_;
+		data += chunk_;
+		len -= chunk_;
+		if (COMPRESS.fill == DBJ_LOG_COMPRESS_BLOCK) compress_seal_();
+	}
+	ReleaseSRWLockExclusive(&COMPRESS.guard);
+}
+
+static DWORD WINAPI compress_worker_(LPVOID unused_)
+{
+	(void)unused_;
+	AcquireSRWLockExclusive(&COMPRESS.guard);
+
+	for (;;)
+	{
+		if (COMPRESS.sealed_count) {
+			char* data_ = COMPRESS.sealed[COMPRESS.sealed_first].data;
+			const size_t len_ = COMPRESS.sealed[COMPRESS.sealed_first].len;
+			COMPRESS.sealed_first = (COMPRESS.sealed_first + 1) % DBJ_LOG_COMPRESS_BLOCKS;
+			COMPRESS.sealed_count -= 1;
+			ReleaseSRWLockExclusive(&COMPRESS.guard);
+
+			compress_frame_write_(data_, len_);
+
+			AcquireSRWLockExclusive(&COMPRESS.guard);
+			COMPRESS.free_blocks[COMPRESS.free_count++] = data_;
+			WakeConditionVariable(&COMPRESS.room);
+			continue;
+		}
+
+		if (COMPRESS.stop) break;
+
+		/* nothing for a while, what is there is written, the free block is there, no waiting */
+		if (!SleepConditionVariableSRW(&COMPRESS.work, &COMPRESS.guard, DBJ_LOG_COMPRESS_FLUSH_MS, 0)
+			&& !COMPRESS.sealed_count && !COMPRESS.stop && COMPRESS.current && COMPRESS.free_count)
+			compress_seal_();
+	}
+
+	ReleaseSRWLockExclusive(&COMPRESS.guard);
+	return 0;
+}
+
+static bool compress_open_(const char* file_name)
+{
+	COMPRESS.fp = _fsopen(file_name, "wbc", _SH_DENYWR);
+	if (!COMPRESS.fp) {
+		DBJ_PERROR;
+		return false;
+	}
+
+	COMPRESS.out_cap = lz4_bound_(DBJ_LOG_COMPRESS_BLOCK);
+	COMPRESS.out = (unsigned char*)malloc(COMPRESS.out_cap);
+	COMPRESS.current = (char*)malloc(DBJ_LOG_COMPRESS_BLOCK);
+	for (int j = 0; j < DBJ_LOG_COMPRESS_BLOCKS; ++j) {
+		char* block_ = (char*)malloc(DBJ_LOG_COMPRESS_BLOCK);
+		if (block_) COMPRESS.free_blocks[COMPRESS.free_count++] = block_;
+	}
+
+	if (COMPRESS.out && COMPRESS.current && COMPRESS.free_count)
+		COMPRESS.worker = CreateThread(NULL, 0, compress_worker_, NULL, 0, NULL);
+
+	if (!COMPRESS.worker) {
+		DBJ_PERROR;
+		fclose(COMPRESS.fp);
+		COMPRESS.fp = NULL;
+		return false;
+	}
+	return true;
+}
+
+/* the last block, the seek table */
+static void compress_close_(void)
+{
+	if (!COMPRESS.fp) return;
+
+	AcquireSRWLockExclusive(&COMPRESS.guard);
+	compress_seal_();
+	COMPRESS.stop = true;
+	WakeConditionVariable(&COMPRESS.work);
+	ReleaseSRWLockExclusive(&COMPRESS.guard);
+
+	/* still compressing, process is going down anyway, leave it all to the OS */
+	if (WAIT_OBJECT_0 != WaitForSingleObject(COMPRESS.worker, 5000)) return;
+	CloseHandle(COMPRESS.worker);
+	COMPRESS.worker = NULL;
+
+	const dbj_log_seek_trailer trailer_ = {
+		COMPRESS.offset,
+		(unsigned)COMPRESS.seek_count,
+		DBJ_LOG_SEEK_MAGIC
+	};
+	fwrite(COMPRESS.seek, sizeof(dbj_log_seek_entry), COMPRESS.seek_count, COMPRESS.fp);
+	fwrite(&trailer_, sizeof(trailer_), 1, COMPRESS.fp);
+	fclose(COMPRESS.fp);
+	COMPRESS.fp = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// console sink, DBJ_LOG_CONSOLE_ASYNC
+///
+/// console lines are appended to the bounded byte ring, under the log lock
+/// the writer thread takes all that is there, in one write
+/// slow terminal or the pipe nobody reads, does not stop the logging
+/// line that does not fit is dropped, and counted, the writer tells how many
+/// on close the writer empties the buffer and flushes, only then the lines
+/// go to the console directly, none of them overtakes the ones buffered
+
+static struct {
+	char* buf;
+	size_t used;
+	/* where the writer reads from, the next line goes to (first + used) % size */
+	size_t first;
+	HANDLE writer;
+	SRWLOCK guard;
+	CONDITION_VARIABLE work;
+	bool stop;
+	/* writer is done, buffer is written and flushed, lines go directly */
+	bool drained;
+	volatile LONG64 dropped;
+	/* writer only */
+	long long dropped_told;
+} CONSOLE;
+
+/* under the log lock */
+static void console_append_(const char* data, size_t len)
+{
+	AcquireSRWLockExclusive(&CONSOLE.guard);
+
+	if (CONSOLE.drained) {
+		fwrite(data, 1, len, stderr);
+		ReleaseSRWLockExclusive(&CONSOLE.guard);
+		return;
+	}
+
+	if (len > DBJ_LOG_CONSOLE_BUFFER - CONSOLE.used) {
+		ReleaseSRWLockExclusive(&CONSOLE.guard);
+		InterlockedIncrement64(&CONSOLE.dropped);
+		return;
+	}
+
+	const size_t at_ = (CONSOLE.first + CONSOLE.used) % DBJ_LOG_CONSOLE_BUFFER;
+	const size_t head_ = len < DBJ_LOG_CONSOLE_BUFFER - at_ ? len : DBJ_LOG_CONSOLE_BUFFER - at_;
+	memcpy(CONSOLE.buf + at_, data, head_);
+	memcpy(CONSOLE.buf, data + head_, len - head_);
+
+	const bool was_empty_ = CONSOLE.used == 0;
+	CONSOLE.used += len;
+	ReleaseSRWLockExclusive(&CONSOLE.guard);
+
+	if (was_empty_) WakeConditionVariable(&CONSOLE.work);
+}
+
+static DWORD WINAPI console_writer_(LPVOID unused_)
+{
+	(void)unused_;
+	AcquireSRWLockExclusive(&CONSOLE.guard);
+
+	for (;;)
+	{
+		if (CONSOLE.used) {
+			/* the part up to the end of the buffer, the rest on the next round */
+			const size_t first_ = CONSOLE.first;
+			const size_t chunk_ = CONSOLE.used < DBJ_LOG_CONSOLE_BUFFER - first_ ? CONSOLE.used : DBJ_LOG_CONSOLE_BUFFER - first_;
+			ReleaseSRWLockExclusive(&CONSOLE.guard);
+
+			/* appenders do not touch the bytes in use, no guard needed */
+			fwrite(CONSOLE.buf + first_, 1, chunk_, stderr);
+
+			const long long dropped_ = CONSOLE.dropped;
+			if (dropped_ != CONSOLE.dropped_told) {
+				fprintf(stderr, "dbj simple log: %lld console lines dropped so far\n", dropped_);
+				CONSOLE.dropped_told = dropped_;
+			}
+
+			AcquireSRWLockExclusive(&CONSOLE.guard);
+			CONSOLE.first = (first_ + chunk_) % DBJ_LOG_CONSOLE_BUFFER;
+			CONSOLE.used -= chunk_;
+			continue;
+		}
+
+		if (CONSOLE.stop) break;
+		SleepConditionVariableSRW(&CONSOLE.work, &CONSOLE.guard, INFINITE, 0);
+	}
+
+	/* still under the guard: the next line can not go out before these */
+	if (CONSOLE.dropped != CONSOLE.dropped_told)
+		fprintf(stderr, "dbj simple log: %lld console lines dropped\n", (long long)CONSOLE.dropped);
+	fflush(stderr);
+	CONSOLE.drained = true;
+
+	ReleaseSRWLockExclusive(&CONSOLE.guard);
+	return 0;
+}
+
+static bool console_open_(void)
+{
+	CONSOLE.buf = (char*)malloc(DBJ_LOG_CONSOLE_BUFFER);
+	if (CONSOLE.buf)
+		CONSOLE.writer = CreateThread(NULL, 0, console_writer_, NULL, 0, NULL);
+
+	if (!CONSOLE.writer) {
+		/* console is then written directly */
+		DBJ_PERROR;
+		free(CONSOLE.buf);
+		CONSOLE.buf = NULL;
+		return false;
+	}
+	return true;
+}
+
+/*
+what is in the buffer is written and flushed first, by the writer
+lines logged meanwhile are buffered behind them, or written directly
+by console_append_ once the writer is done, under the guard both
+*/
+static void console_close_(void)
+{
+	if (!CONSOLE.writer) return;
+
+	AcquireSRWLockExclusive(&CONSOLE.guard);
+	CONSOLE.stop = true;
+	ReleaseSRWLockExclusive(&CONSOLE.guard);
+	WakeConditionVariable(&CONSOLE.work);
+
+	/* stderr is stuck, process is going down anyway, leave it all to the OS */
+	if (WAIT_OBJECT_0 != WaitForSingleObject(CONSOLE.writer, 2000)) return;
+
+	lock();
+	HANDLE writer_ = CONSOLE.writer;
+	CONSOLE.writer = NULL;
+	unlock();
+
+	CloseHandle(writer_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// network sink, DBJ_LOG_NET
+///
+/// file lines are appended to the bounded byte ring, under the log lock
+/// the sender thread ships them in batches, as frames: dbj_log_frame_header
+/// then LZ4 block or raw bytes, same as DBJ_LOG_COMPRESS file frames
+/// TCP stream of frames, or one frame per UDP datagram
+/// while the collector is not there, frames go to the spool file
+/// spool is sent first, once the collector is back, even on the next run
+/// line that does not fit the ring is dropped, and counted
+/// winsock only with DBJ_LOG_NET_ENABLED, without it DBJ_LOG_NET is refused
+
+#ifdef DBJ_LOG_NET_ENABLED
+
+static_assert(!DBJ_LOG_NET_UDP || DBJ_LOG_NET_BATCH + 2 * sizeof(dbj_log_frame_header) <= 65507,
+	"DBJ_LOG_NET_BATCH frame must fit the UDP datagram");
+
+static struct {
+	char* buf;
+	size_t used;
+	/* where the sender reads from, the next line goes to (first + used) % size */
+	size_t first;
+	HANDLE sender;
+	SRWLOCK guard;
+	CONDITION_VARIABLE work;
+	bool stop;
+	volatile LONG64 dropped;
+	/* under the guard, see dbj_log_net_endpoint */
+	char host[256];
+	char port[16];
+	bool endpoint_changed;
+	/* sender only */
+	bool wsa;
+	SOCKET sock;
+	ULONGLONG retry_at;
+	FILE* spool;
+	/* spool bytes sent already, and the spool size */
+	long long spool_sent;
+	long long spool_end;
+	char* batch;
+	/* frame header and the payload, sent or spooled as is */
+	unsigned char* frame;
+	/* spool frame being sent */
+	unsigned char* replay;
+	unsigned table[1 << compress_hash_bits_];
+	volatile LONG64 frames_sent;
+	volatile LONG64 frames_spooled;
+	/* no spool and no collector */
+	volatile LONG64 frames_lost;
+} NET = { .sock = INVALID_SOCKET };
+
+#define net_frame_cap_ (sizeof(dbj_log_frame_header) + lz4_bound_(DBJ_LOG_NET_BATCH))
+
+/* under the log lock */
+static void net_append_(const char* data, size_t len)
+{
+	AcquireSRWLockExclusive(&NET.guard);
+
+	if (len > DBJ_LOG_NET_BUFFER - NET.used) {
+		ReleaseSRWLockExclusive(&NET.guard);
+		InterlockedIncrement64(&NET.dropped);
+		return;
+	}
+
+	const size_t at_ = (NET.first + NET.used) % DBJ_LOG_NET_BUFFER;
+	const size_t head_ = len < DBJ_LOG_NET_BUFFER - at_ ? len : DBJ_LOG_NET_BUFFER - at_;
+	memcpy(NET.buf + at_, data, head_);
+	memcpy(NET.buf, data + head_, len - head_);
+
+	NET.used += len;
+	const bool batch_full_ = NET.used >= DBJ_LOG_NET_BATCH;
+	ReleaseSRWLockExclusive(&NET.guard);
+
+	if (batch_full_) WakeConditionVariable(&NET.work);
+}
+
+static void net_disconnect_(void)
+{
+	if (NET.sock == INVALID_SOCKET) return;
+	closesocket(NET.sock);
+	NET.sock = INVALID_SOCKET;
+	NET.retry_at = GetTickCount64() + DBJ_LOG_NET_RETRY_MS;
+}
+
+/*
+TCP: non blocking connect, waited for until the deadline, then blocking again
+collector host that does not answer does not stop the sender for longer
+UDP: connect only sets the peer
+*/
+static bool net_connect_one_(SOCKET sock, const struct addrinfo* ai, ULONGLONG deadline)
+{
+	if (DBJ_LOG_NET_UDP) return SOCKET_ERROR != connect(sock, ai->ai_addr, (int)ai->ai_addrlen);
+
+	u_long non_blocking_ = 1;
+	if (SOCKET_ERROR == ioctlsocket(sock, FIONBIO, &non_blocking_)) return false;
+
+	bool connected_ = SOCKET_ERROR != connect(sock, ai->ai_addr, (int)ai->ai_addrlen);
+	const ULONGLONG now_ = GetTickCount64();
+
+	if (!connected_ && WSAGetLastError() == WSAEWOULDBLOCK && now_ < deadline) {
+		const long wait_ms_ = (long)(deadline - now_);
+		const struct timeval timeout_ = { wait_ms_ / 1000, (wait_ms_ % 1000) * 1000 };
+		fd_set writable_, failed_;
+		FD_ZERO(&writable_);
+		FD_SET(sock, &writable_);
+		FD_ZERO(&failed_);
+		FD_SET(sock, &failed_);
+		/* refused connect is in the except set, on Windows */
+		if (1 == select(0, NULL, &writable_, &failed_, &timeout_) && FD_ISSET(sock, &writable_)) {
+			int error_ = 0, error_len_ = sizeof(error_);
+			connected_ = 0 == getsockopt(sock, SOL_SOCKET, SO_ERROR, (char*)&error_, &error_len_) && error_ == 0;
+		}
+	}
+
+	non_blocking_ = 0;
+	return connected_ && SOCKET_ERROR != ioctlsocket(sock, FIONBIO, &non_blocking_);
+}
+
+/*
+false if there is no collector, not tried again before DBJ_LOG_NET_RETRY_MS
+all the addresses of the host together are not tried longer than that either
+*/
+static bool net_connect_(void)
+{
+	AcquireSRWLockExclusive(&NET.guard);
+	const bool changed_ = NET.endpoint_changed;
+	char host_[sizeof(NET.host)], port_[sizeof(NET.port)];
+	memcpy(host_, NET.host, sizeof(host_));
+	memcpy(port_, NET.port, sizeof(port_));
+	NET.endpoint_changed = false;
+	ReleaseSRWLockExclusive(&NET.guard);
+
+	if (changed_) {
+		net_disconnect_();
+		NET.retry_at = 0;
+	}
+
+	if (NET.sock != INVALID_SOCKET) return true;
+	if (GetTickCount64() < NET.retry_at) return false;
+
+	struct addrinfo hints_ = { 0 };
+	hints_.ai_family = AF_UNSPEC;
+	hints_.ai_socktype = DBJ_LOG_NET_UDP ? SOCK_DGRAM : SOCK_STREAM;
+	hints_.ai_protocol = DBJ_LOG_NET_UDP ? IPPROTO_UDP : IPPROTO_TCP;
+
+	const ULONGLONG deadline_ = GetTickCount64() + DBJ_LOG_NET_RETRY_MS;
+	struct addrinfo* found_ = NULL;
+	if (0 == getaddrinfo(host_, port_, &hints_, &found_)) {
+		for (struct addrinfo* ai = found_; ai && NET.sock == INVALID_SOCKET; ai = ai->ai_next) {
+			SOCKET sock_ = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+			if (sock_ == INVALID_SOCKET) continue;
+			if (!net_connect_one_(sock_, ai, deadline_)) {
+				closesocket(sock_);
+				continue;
+			}
+			/* stuck collector is the same as no collector */
+			const DWORD timeout_ = DBJ_LOG_NET_RETRY_MS;
+			setsockopt(sock_, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeout_, sizeof(timeout_));
+			NET.sock = sock_;
+		}
+		freeaddrinfo(found_);
+	}
+
+	if (NET.sock == INVALID_SOCKET) {
+		NET.retry_at = GetTickCount64() + DBJ_LOG_NET_RETRY_MS;
+		return false;
+	}
+	return true;
+}
+
+/*
+one frame, false and disconnected on error, the caller spools it
+UDP: datagram sent is not known to be received, nothing is spooled for it
+ICMP port unreachable of some earlier datagram fails this send, WSAECONNRESET
+from then on frames are spooled, until the collector is back
+*/
+static bool net_send_(const unsigned char* frame, size_t len)
+{
+	while (len) {
+		const int sent_ = send(NET.sock, (const char*)frame, (int)len, 0);
+		if (sent_ == SOCKET_ERROR || sent_ <= 0) {
+			/* TCP: collector drops the partial frame, it is sent again whole */
+			net_disconnect_();
+			return false;
+		}
+		frame += sent_;
+		len -= (size_t)sent_;
+	}
+	InterlockedIncrement64(&NET.frames_sent);
+	return true;
+}
+
+static void net_spool_(const unsigned char* frame, size_t len)
+{
+	if (!NET.spool) {
+		InterlockedIncrement64(&NET.frames_lost);
+		return;
+	}
+	_fseeki64(NET.spool, 0, SEEK_END);
+	fwrite(frame, 1, len, NET.spool);
+	fflush(NET.spool);
+	DBJ_FERROR(NET.spool);
+	NET.spool_end = _ftelli64(NET.spool);
+	InterlockedIncrement64(&NET.frames_spooled);
+}
+
+/*
+spool frames are sent in order, false if the collector went away
+all sent, or the rest is not readable, and the spool is emptied
+*/
+static bool net_replay_(void)
+{
+	if (!NET.spool || NET.spool_sent >= NET.spool_end) return true;
+
+	_fseeki64(NET.spool, NET.spool_sent, SEEK_SET);
+
+	dbj_log_frame_header header_;
+	while (NET.spool_sent < NET.spool_end)
+	{
+		/* torn frame at the end, after the crash */
+		if (1 != fread(&header_, sizeof(header_), 1, NET.spool) || header_.magic != DBJ_LOG_FRAME_MAGIC
+			|| header_.stored_size > net_frame_cap_ - sizeof(header_)) break;
+
+		memcpy(NET.replay, &header_, sizeof(header_));
+		if (header_.stored_size != fread(NET.replay + sizeof(header_), 1, header_.stored_size, NET.spool)) break;
+
+		const size_t len_ = sizeof(header_) + header_.stored_size;
+		if (!net_send_(NET.replay, len_)) return false;
+		NET.spool_sent += (long long)len_;
+	}
+
+	(void)_chsize_s(_fileno(NET.spool), 0);
+	NET.spool_sent = NET.spool_end = 0;
+	return true;
+}
+
+static void net_ship_(const char* raw, size_t len)
+{
+	const size_t packed_ = DBJ_LOG_NET_COMPRESS ?
+		lz4_compress_((const unsigned char*)raw, len, NET.frame + sizeof(dbj_log_frame_header), NET.table) : len;
+	const bool stored_ = packed_ >= len;
+
+	const dbj_log_frame_header header_ = {
+		DBJ_LOG_FRAME_MAGIC,
+		(unsigned)(stored_ ? len : packed_),
+		(unsigned)len,
+		stored_ ? DBJ_LOG_FRAME_RAW : 0u
+	};
+	memcpy(NET.frame, &header_, sizeof(header_));
+	if (stored_) memcpy(NET.frame + sizeof(header_), raw, len);
+	const size_t frame_len_ = sizeof(header_) + header_.stored_size;
+
+	/* spool first, the order is kept */
+	if (net_connect_() && net_replay_() && net_send_(NET.frame, frame_len_)) return;
+
+	net_spool_(NET.frame, frame_len_);
+}
+
+static DWORD WINAPI net_sender_(LPVOID unused_)
+{
+	(void)unused_;
+	AcquireSRWLockExclusive(&NET.guard);
+
+	for (;;)
+	{
+		if (NET.used) {
+			const size_t first_ = NET.first;
+			size_t len_ = NET.used < DBJ_LOG_NET_BATCH ? NET.used : DBJ_LOG_NET_BATCH;
+			ReleaseSRWLockExclusive(&NET.guard);
+
+			/* appenders do not touch the bytes in use, no guard needed */
+			const size_t head_ = len_ < DBJ_LOG_NET_BUFFER - first_ ? len_ : DBJ_LOG_NET_BUFFER - first_;
+			memcpy(NET.batch, NET.buf + first_, head_);
+			memcpy(NET.batch + head_, NET.buf, len_ - head_);
+
+			/* whole lines in the batch, unless the line is longer than the batch */
+			if (len_ == DBJ_LOG_NET_BATCH) {
+				size_t end_ = len_;
+				while (end_ && NET.batch[end_ - 1] != '\n') --end_;
+				if (end_) len_ = end_;
+			}
+
+			net_ship_(NET.batch, len_);
+
+			AcquireSRWLockExclusive(&NET.guard);
+			NET.first = (first_ + len_) % DBJ_LOG_NET_BUFFER;
+			NET.used -= len_;
+			continue;
+		}
+
+		if (NET.stop) break;
+
+		/* not a full batch for a while, what is there is sent */
+		SleepConditionVariableSRW(&NET.work, &NET.guard, DBJ_LOG_NET_FLUSH_MS, 0);
+
+		/* nothing new, collector might be back for the spool */
+		if (!NET.used && NET.spool_sent < NET.spool_end) {
+			ReleaseSRWLockExclusive(&NET.guard);
+			if (net_connect_()) (void)net_replay_();
+			AcquireSRWLockExclusive(&NET.guard);
+		}
+	}
+
+	ReleaseSRWLockExclusive(&NET.guard);
+	return 0;
+}
+
+static bool net_open_(const char* app_full_path)
+{
+	WSADATA wsa_;
+	if (0 != WSAStartup(MAKEWORD(2, 2), &wsa_)) {
+		DBJ_PERROR;
+		return false;
+	}
+	NET.wsa = true;
+
+	strncpy_s(NET.host, sizeof(NET.host), DBJ_LOG_NET_HOST, _TRUNCATE);
+	strncpy_s(NET.port, sizeof(NET.port), DBJ_LOG_NET_PORT, _TRUNCATE);
+
+	/* spool is kept, what is left from the last run is sent first */
+	if (app_full_path) {
+		dbj_fhandle spool_file_ = dbj_fhandle_make(app_full_path);
+		strncat_s(spool_file_.name, dbj_fhandle_max_name_len, ".spool", _TRUNCATE);
+		NET.spool = _fsopen(spool_file_.name, "a+b", _SH_DENYWR);
+		if (NET.spool) {
+			_fseeki64(NET.spool, 0, SEEK_END);
+			NET.spool_end = _ftelli64(NET.spool);
+		}
+		else {
+			DBJ_PERROR;
+		}
+	}
+
+	NET.buf = (char*)malloc(DBJ_LOG_NET_BUFFER);
+	NET.batch = (char*)malloc(DBJ_LOG_NET_BATCH);
+	NET.frame = (unsigned char*)malloc(net_frame_cap_);
+	NET.replay = (unsigned char*)malloc(net_frame_cap_);
+
+	if (NET.buf && NET.batch && NET.frame && NET.replay)
+		NET.sender = CreateThread(NULL, 0, net_sender_, NULL, 0, NULL);
+
+	if (!NET.sender) {
+		DBJ_PERROR;
+		free(NET.buf);
+		free(NET.batch);
+		free(NET.frame);
+		free(NET.replay);
+		NET.buf = NET.batch = NULL;
+		NET.frame = NET.replay = NULL;
+		if (NET.spool) fclose(NET.spool);
+		NET.spool = NULL;
+		WSACleanup();
+		NET.wsa = false;
+		return false;
+	}
+	return true;
+}
+
+/* what is in the ring is sent or spooled, later lines are not shipped */
+static void net_close_(void)
+{
+	if (!NET.sender) return;
+
+	lock();
+	HANDLE sender_ = NET.sender;
+	NET.sender = NULL;
+	unlock();
+
+	AcquireSRWLockExclusive(&NET.guard);
+	NET.stop = true;
+	ReleaseSRWLockExclusive(&NET.guard);
+	WakeConditionVariable(&NET.work);
+
+	/* collector is stuck, process is going down anyway, leave it all to the OS */
+	if (WAIT_OBJECT_0 != WaitForSingleObject(sender_, 2 * DBJ_LOG_NET_RETRY_MS)) return;
+	CloseHandle(sender_);
+
+	if (NET.sock != INVALID_SOCKET) {
+		shutdown(NET.sock, SD_SEND);
+		closesocket(NET.sock);
+		NET.sock = INVALID_SOCKET;
+	}
+	if (NET.spool) fclose(NET.spool);
+	NET.spool = NULL;
+	if (NET.wsa) WSACleanup();
+	NET.wsa = false;
+}
+
+void dbj_log_net_endpoint(const char* host, const char* port)
+{
+	AcquireSRWLockExclusive(&NET.guard);
+	if (host) strncpy_s(NET.host, sizeof(NET.host), host, _TRUNCATE);
+	if (port) strncpy_s(NET.port, sizeof(NET.port), port, _TRUNCATE);
+	NET.endpoint_changed = true;
+	ReleaseSRWLockExclusive(&NET.guard);
+	WakeConditionVariable(&NET.work);
+}
+
+#else // ! DBJ_LOG_NET_ENABLED
+
+/* never started, the log path does not look further */
+static const struct {
+	HANDLE sender;
+} NET = { NULL };
+
+static void net_append_(const char* data, size_t len)
+{
+	(void)data; (void)len;
+}
+
+static bool net_open_(const char* app_full_path)
+{
+	(void)app_full_path;
+	// DBJ_LOG_NET in the runtime setup, define DBJ_LOG_NET_ENABLED
+	DBJ_ASSERT(false);
+	return false;
+}
+
+static void net_close_(void) {}
+
+void dbj_log_net_endpoint(const char* host, const char* port)
+{
+	(void)host; (void)port;
+}
+
+#endif // ! DBJ_LOG_NET_ENABLED
+
+static void log_set_fp(FILE* fp, const char* file_path_name) {
+
+	DBJ_ASSERT(fp);
+	LOCAL.fp = fp;
+
+	if (!file_path_name) {
+		/* name not given */
+		LOCAL.log_f_name[0] = '\0';
+		return;
+	}
+	set_log_file_name(file_path_name);
+}
+
+
+static void time_stamp_(char(*buf)[32], bool short_, time_t t)
+{
+	struct tm lt;
+	errno_t errno_rez = localtime_s(&lt, &t);
+	DBJ_ASSERT(errno_rez == 0);
+	if (short_)
+		(*buf)[strftime((*buf), sizeof(*buf), "%H:%M:%S", &lt)] = '\0';
+	else
+		(*buf)[strftime((*buf), sizeof(*buf), "%Y-%m-%d %H:%M:%S", &lt)] = '\0';
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// clock, DBJ_LOG_TSC_TIMESTAMP
+///
+/// invariant TSC if the CPU has it, QPC if not, no syscall per line
+/// calibration pair, ticks and the wall time, is taken at the start and then
+/// every DBJ_LOG_CLOCK_CALIBRATE_MS, ticks are turned into the wall time with it
+/// seconds of the stamp are rendered once per second, nanoseconds are appended
+/// stamps are taken under the lock, thus strictly ordered
+/// clock is made once, by whoever reads it first, the setup or the scope before it,
+/// TSC or QPC is chosen then and never changed, scope begin and end use the same one
+
+static struct {
+	INIT_ONCE once;
+	volatile LONG ready;
+	bool tsc;
+	/* ticks per second */
+	long long freq;
+	/* the first pair, TSC frequency is measured over the whole run */
+	long long first_ticks;
+	long long first_qpc;
+	/* calibration pair, wall time is ns since 1970 */
+	long long base_ticks;
+	long long base_wall;
+	long long next_calibration;
+	/* no going back after the calibration */
+	long long last_wall;
+	/* rendered seconds of the stamp */
+	long long stamp_second;
+	bool stamp_short;
+	char stamp[32];
+	size_t stamp_len;
+} CLOCK = { INIT_ONCE_STATIC_INIT };
+
+/* TSC is wanted by the default setup, or by the one given at runtime */
+#define clock_tsc_wanted_ (0 != ((DBJ_LOG_DEFAULT_SETUP) & DBJ_LOG_TSC_TIMESTAMP) || LOCAL.tsc_stamp)
+
+static void clock_ready_(void);
+
+static long long clock_qpc_(void)
+{
+	LARGE_INTEGER now_;
+	QueryPerformanceCounter(&now_);
+	return now_.QuadPart;
+}
+
+static long long clock_wall_now_(void)
+{
+	FILETIME ft_;
+	GetSystemTimePreciseAsFileTime(&ft_);
+	/* 100ns since 1601 */
+	const long long since_1601_ = (long long)(((unsigned long long)ft_.dwHighDateTime << 32) | ft_.dwLowDateTime);
+	return (since_1601_ - 116444736000000000ll) * 100;
+}
+
+static bool clock_invariant_tsc_(void)
+{
+	int regs_[4] = { 0 };
+	__cpuid(regs_, (int)0x80000000);
+	if ((unsigned)regs_[0] < 0x80000007u) return false;
+	__cpuid(regs_, (int)0x80000007);
+	return 0 != (regs_[3] & (1 << 8));
+}
+
+static long long clock_ticks_(void)
+{
+	if (!CLOCK.ready) clock_ready_();
+	return CLOCK.tsc ? (long long)__rdtsc() : clock_qpc_();
+}
+
+static void clock_calibrate_(long long ticks)
+{
+	if (CLOCK.tsc) {
+		LARGE_INTEGER qfreq_;
+		QueryPerformanceFrequency(&qfreq_);
+		const long long qpc_ = clock_qpc_();
+		/* at least a second, to be better than the startup measurement */
+		if (qpc_ - CLOCK.first_qpc > qfreq_.QuadPart)
+			CLOCK.freq = (long long)((double)(ticks - CLOCK.first_ticks) * (double)qfreq_.QuadPart
+				/ (double)(qpc_ - CLOCK.first_qpc));
+	}
+	CLOCK.base_ticks = ticks;
+	CLOCK.base_wall = clock_wall_now_();
+	CLOCK.next_calibration = ticks + CLOCK.freq / 1000 * DBJ_LOG_CLOCK_CALIBRATE_MS;
+}
+
+/* TSC wanted or not, QPC is used if there is no invariant TSC */
+static BOOL CALLBACK clock_init_(INIT_ONCE* once_, PVOID param_, PVOID* context_)
+{
+	(void)once_; (void)param_; (void)context_;
+
+	LARGE_INTEGER qfreq_;
+	QueryPerformanceFrequency(&qfreq_);
+
+	CLOCK.tsc = clock_tsc_wanted_ && clock_invariant_tsc_();
+	if (CLOCK.tsc) {
+		/* one millisecond, refined on each calibration */
+		const long long q0_ = clock_qpc_();
+		const long long t0_ = (long long)__rdtsc();
+		long long q1_ = q0_;
+		while (q1_ - q0_ < qfreq_.QuadPart / 1000) q1_ = clock_qpc_();
+		const long long t1_ = (long long)__rdtsc();
+
+		CLOCK.freq = (t1_ - t0_) * qfreq_.QuadPart / (q1_ - q0_);
+		CLOCK.first_ticks = t0_;
+		CLOCK.first_qpc = q0_;
+	}
+	else {
+		CLOCK.freq = qfreq_.QuadPart;
+	}
+	clock_calibrate_(CLOCK.tsc ? (long long)__rdtsc() : clock_qpc_());
+	InterlockedExchange(&CLOCK.ready, 1);
+	return TRUE;
+}
+
+static void clock_ready_(void)
+{
+	InitOnceExecuteOnce(&CLOCK.once, clock_init_, NULL, NULL);
+}
+
+/* ticks to ns, no overflow for days */
+static long long clock_ns_(long long ticks)
+{
+	if (!CLOCK.ready) clock_ready_();
+	if (ticks < 0) return 0;
+	return ticks / CLOCK.freq * 1000000000 + (ticks % CLOCK.freq) * 1000000000 / CLOCK.freq;
+}
+
+/* under the lock, ns since 1970, strictly growing */
+static long long clock_wall_(long long ticks)
+{
+	if (ticks >= CLOCK.next_calibration) clock_calibrate_(ticks);
+
+	long long wall_ = CLOCK.base_wall + clock_ns_(ticks - CLOCK.base_ticks);
+	if (wall_ <= CLOCK.last_wall) wall_ = CLOCK.last_wall + 1;
+	CLOCK.last_wall = wall_;
+	return wall_;
+}
+
+/* under the lock, returns the stamp length, seconds are in *t */
+static size_t clock_stamp_(char(*buf)[32], bool short_, long long ticks, time_t* t)
+{
+	const long long wall_ = clock_wall_(ticks);
+	const long long second_ = wall_ / 1000000000;
+
+	if (second_ != CLOCK.stamp_second || short_ != CLOCK.stamp_short || !CLOCK.stamp_len) {
+		time_stamp_(&CLOCK.stamp, short_, (time_t)second_);
+		CLOCK.stamp_len = strlen(CLOCK.stamp);
+		CLOCK.stamp_second = second_;
+		CLOCK.stamp_short = short_;
+	}
+
+	char digits[12];
+	const int n = u64_to_dec_((unsigned long long)(wall_ % 1000000000), digits + sizeof(digits));
+
+	memcpy(*buf, CLOCK.stamp, CLOCK.stamp_len);
+	char* w = *buf + CLOCK.stamp_len;
+	*w++ = '.';
+	memset(w, '0', (size_t)(9 - n));
+	memcpy(w + 9 - n, digits + sizeof(digits) - n, (size_t)n);
+	w[9] = '\0';
+
+	*t = (time_t)second_;
+	return CLOCK.stamp_len + 10;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// logging cost per call site, DBJ_LOG_PROFILE
+///
+/// site is file and line given to the log call, batch is its begin site
+/// calls, bytes written and time spent, from after the level and sampling
+/// decision to the end of the write, formatting included
+/// lock free: slot is claimed with CAS, counters are interlocked
+
+typedef struct profile_site_ {
+	log_site_ at;
+	volatile LONG64 calls;
+	volatile LONG64 bytes;
+	volatile LONG64 ticks;
+} profile_site_;
+
+static struct {
+	bool on;
+	/* calls not counted, the table was full */
+	volatile LONG64 lost;
+	profile_site_ sites[DBJ_LOG_PROFILE_SITES];
+} PROFILE;
+
+static profile_site_* profile_site_find_(const char* file, int line)
+{
+	static_assert((DBJ_LOG_PROFILE_SITES & (DBJ_LOG_PROFILE_SITES - 1)) == 0,
+		"DBJ_LOG_PROFILE_SITES must be a power of two");
+	static_assert(offsetof(profile_site_, at) == 0, "log_site_ must be the first");
+
+	return (profile_site_*)log_site_find_(PROFILE.sites, sizeof(profile_site_), DBJ_LOG_PROFILE_SITES,
+		file, line, true, NULL, NULL);
+}
+
+static void profile_note_(const char* file, int line, long long calls, size_t bytes, long long ticks)
+{
+	profile_site_* site = profile_site_find_(file, line);
+	if (!site) {
+		InterlockedExchangeAdd64(&PROFILE.lost, calls);
+		return;
+	}
+	InterlockedExchangeAdd64(&site->calls, calls);
+	InterlockedExchangeAdd64(&site->bytes, (LONG64)bytes);
+	InterlockedExchangeAdd64(&site->ticks, ticks);
+}
+
+/* the site counters, read once, the report is made of these */
+typedef struct profile_row_ {
+	const char* file;
+	LONG line;
+	long long calls;
+	long long bytes;
+	long long ticks;
+} profile_row_;
+
+/* most time first */
+static int profile_order_(const void* left, const void* right)
+{
+	const long long a = ((const profile_row_*)left)->ticks;
+	const long long b = ((const profile_row_*)right)->ticks;
+	return (a < b) - (a > b);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// public funs
+const char* const dbj_simplelog_file_path() {
+	return LOCAL.log_f_name;
+}
+
+void dbj_simple_log_set_level(int level) {
+	DBJ_ASSERT(level >= DBJ_LOG_TRACE && level <= DBJ_LOG_FATAL);
+	LOCAL.level = level;
+}
+
+int dbj_simple_log_effective_level(void) {
+	const int floor_ = (int)DEGRADE.floor;
+	return floor_ > LOCAL.level ? floor_ : LOCAL.level;
+}
+
+/*
+startup state
+0 -- not yet, 1 -- in progress, 2 -- done
+banner lines logged by the thread doing the startup
+must pass through, all the other threads wait
+*/
+static LONG volatile startup_state_ = 0;
+static DWORD volatile startup_thread_ = 0;
+
+/* DBJ_LOG_LAZY startup is done on the first log line */
+static void startup_once_(void);
+
+/*
+level, backpressure and sampling, before any time or formatting work
+returns 0 if not to be logged, otherwise the sampling weight
+*/
+static unsigned log_admit_(int level, const char* file, int line, sample_site_** site)
+{
+	if (level < LOCAL.level) return 0;
+#if DBJ_LOG_DEGRADE_LATENCY_US
+	/* degraded under backpressure */
+	if (level < DEGRADE.floor && !degrade_probe_()) return 0;
+#endif // DBJ_LOG_DEGRADE_LATENCY_US
+
+	unsigned weight_ = 1;
+	if (SAMPLE.on) {
+		weight_ = sample_weight_(level, file, line, site);
+		if (weight_ == 0) return 0;
+	}
+
+	/* DBJ_LOG_LAZY or logging before the constructor */
+	if (startup_state_ != 2) startup_once_();
+
+	return weight_;
+}
+
+/* message to be logged, file and line of its call site */
+typedef struct log_message_ {
+	const char* file;
+	int line;
+	const char* body;
+	size_t body_len;
+} log_message_;
+
+/*
+here the logging is actually done
+all the messages are logged with one time stamp, one lock and one write per target
+returns the bytes written, to the file if there is one
+*/
+static size_t log_emit_(int level, const log_message_* messages, size_t count,
+	unsigned weight_, sample_site_* site_)
+{
+	if (!PREFIX.made) prefix_templates_make_();
+
+	/* Acquire lock, if MT was part of the setup */
+#if DBJ_LOG_DEGRADE_LATENCY_US
+	const long waiting_ = InterlockedIncrement(&DEGRADE.waiting) - 1;
+	lock();
+	InterlockedDecrement(&DEGRADE.waiting);
+
+	LARGE_INTEGER start_;
+	QueryPerformanceCounter(&start_);
+#else
+	lock();
+#endif // DBJ_LOG_DEGRADE_LATENCY_US
+
+	char timestamp_[32] = { 0 };
+	time_t now_ = 0;
+	size_t stamp_len_ = 0;
+
+	if (log_setup_tsc_stamp_) {
+		stamp_len_ = clock_stamp_(&timestamp_, !log_setup_full_stamp_, clock_ticks_(), &now_);
+	}
+	else {
+		now_ = time(NULL);
+		time_stamp_(&timestamp_, !log_setup_full_stamp_, now_);
+		stamp_len_ = strlen(timestamp_);
+	}
+
+	const int show_ = log_setup_file_line_ ? 1 : 0;
+	line_parts_ parts_ = {
+		timestamp_, stamp_len_,
+		NULL, 0, 0,
+		log_ctx_tls_.fragment, log_ctx_tls_.fragment_len,
+		weight_,
+		NULL, 0
+	};
+
+	size_t out_size_ = 0;
+	for (size_t j = 0; j < count; ++j) {
+		parts_.file_len = strlen(messages[j].file);
+		parts_.body_len = messages[j].body_len;
+		out_size_ += line_size_(&parts_);
+	}
+
+	/* one lines buffer for all the targets */
+	dbj_log_record_* out = record_alloc_(out_size_);
+	size_t console_len_ = 0;
+
+	/* Log to console using stderr */
+	if (out && log_setup_console_) {
+		const int colour_ = PREFIX.colour ? 1 : 0;
+		for (size_t j = 0; j < count; ++j) {
+			parts_.file = messages[j].file;
+			parts_.file_len = strlen(parts_.file);
+			parts_.line = messages[j].line;
+			parts_.body = messages[j].body;
+			parts_.body_len = messages[j].body_len;
+			console_len_ += line_assemble_(dbj_log_record_data(out) + console_len_, &parts_,
+				&PREFIX.console_head[level][colour_][show_],
+				show_ ? &PREFIX.console_mid : NULL, &PREFIX.console_tail[colour_]);
+		}
+
+		if (CONSOLE.writer)
+			console_append_(dbj_log_record_data(out), console_len_);
+		else
+			fwrite(dbj_log_record_data(out), 1, console_len_, stderr);
+
+	} // eof log to console using stderr
+
+	/*
+	ONE: we do not filter out the escape chars
+	TWO: we do add a new line to each line written
+	*/
+	size_t file_len_ = 0;
+	if (out && (RING.shared || COMPRESS.fp || LOCAL.fp || NET.sender)) {
+		for (size_t j = 0; j < count; ++j) {
+			parts_.file = messages[j].file;
+			parts_.file_len = strlen(parts_.file);
+			parts_.line = messages[j].line;
+			parts_.body = messages[j].body;
+			parts_.body_len = messages[j].body_len;
+			char* const at_ = dbj_log_record_data(out) + file_len_;
+			const size_t len = line_assemble_(at_, &parts_,
+				&PREFIX.file_head[level][show_],
+				show_ ? &PREFIX.file_mid : NULL, &PREFIX.file_tail);
+			file_len_ += len;
+
+			/* Log to the shared ring, the collector writes the file, slot is one line */
+			if (RING.shared) {
+				(void)ring_write_(at_, len);
+			}
+		}
+	}
+
+	/* Log to the current block, the worker compresses and writes */
+	if (out && COMPRESS.fp) {
+		compress_append_(dbj_log_record_data(out), file_len_);
+	}
+
+	/* Log to the collector, the sender ships */
+	if (out && NET.sender) {
+		net_append_(dbj_log_record_data(out), file_len_);
+	}
+
+	/* Log to file */
+	if (out && LOCAL.fp) {
+		size_t header_len_ = 0;
+		if (LOCAL.crc) {
+			const dbj_log_crc_header header_ = crc_header_(dbj_log_record_data(out), file_len_);
+			header_len_ = fwrite(&header_, 1, sizeof(header_), LOCAL.fp);
+		}
+		fwrite(dbj_log_record_data(out), 1, file_len_, LOCAL.fp);
+		index_note_(now_, level, count, header_len_ + file_len_);
+
+		DBJ_FERROR(LOCAL.fp);
+
+#ifdef DBJ_SIMPLE_LOG_AUTO_FLUSH
+		DBJ_ASSERT(LOCAL.fp);
+		DBJ_FERROR(LOCAL.fp);
+		if (!LOCAL.flush_suspended)
+			fflush(LOCAL.fp);
+#endif // DBJ_SIMPLE_LOG_AUTO_FLUSH
+
+	}
+
+	const size_t written_ = file_len_ ? file_len_ : console_len_;
+	if (SAMPLE.on)
+		sample_account_(site_, written_);
+
+	record_free_(out);
+
+#if DBJ_LOG_DEGRADE_LATENCY_US
+	LARGE_INTEGER end_;
+	QueryPerformanceCounter(&end_);
+	const bool degraded_ = degrade_note_(start_.QuadPart, end_.QuadPart, waiting_);
+#endif // DBJ_LOG_DEGRADE_LATENCY_US
+
+	/* Release lock */
+	unlock();
+
+#if DBJ_LOG_DEGRADE_LATENCY_US
+
+	/* WARN is never degraded */
+	if (degraded_) {
+		const int floor_ = (int)DEGRADE.floor;
+		if (floor_ > LOCAL.level)
+			dbj_simple_log_log(DBJ_LOG_WARN, __FILE__, __LINE__,
+				"logging degraded, lines below %s are dropped, write latency %lld us, %ld waiting",
+				level_names[floor_], DEGRADE.ewma * 1000000 / DEGRADE.freq, waiting_);
+		else
+			dbj_simple_log_log(DBJ_LOG_WARN, __FILE__, __LINE__,
+				"logging restored, level is %s, write latency %lld us",
+				level_names[LOCAL.level], DEGRADE.ewma * 1000000 / DEGRADE.freq);
+	}
+#endif // DBJ_LOG_DEGRADE_LATENCY_US
+	return written_;
+}
+
+void dbj_simple_log_log(int level, const char* file, int line, const char* fmt, ...)
+{
+	sample_site_* site_ = NULL;
+	const unsigned weight_ = log_admit_(level, file, line, &site_);
+	if (weight_ == 0) return;
+
+	const long long start_ = PROFILE.on ? clock_ticks_() : 0;
+
+	/* message is formatted once, into the pooled record, for all targets */
+	va_list args;
+	va_start(args, fmt);
+	dbj_log_record_* rec = record_format_(fmt, args);
+	va_end(args);
+
+	if (!rec) {
+		DBJ_PERROR;
+		return;
+	}
+
+	const log_message_ message_ = { file, line, dbj_log_record_data(rec), rec->length };
+	const size_t written_ = log_emit_(level, &message_, 1, weight_, site_);
+	record_free_(rec);
+
+	if (PROFILE.on)
+		profile_note_(file, line, 1, written_, clock_ticks_() - start_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// batch of lines
+///
+/// lines are formatted into the thread's own record as they come
+/// and logged together at the end, see log_emit_
+/// lines of the other threads are not in between
+/// level, backpressure and sampling are decided once, at the begin
+
+typedef struct batch_line_ {
+	const char* file;
+	int line;
+	size_t offset;
+	size_t len;
+} batch_line_;
+
+static __declspec(thread) struct {
+	bool open;
+	/* begins inside the open batch, they join it */
+	int nested;
+	int level;
+	/* begin site, for DBJ_LOG_PROFILE */
+	const char* file;
+	int line;
+	long long ticks;
+	/* 0 is not logged */
+	unsigned weight;
+	sample_site_* site;
+	dbj_log_record_* text;
+	size_t used;
+	size_t count;
+	batch_line_ lines[DBJ_LOG_BATCH_LINES];
+} batch_tls_;
+
+/* at least need bytes free in the text, false on no memory */
+static bool batch_reserve_(size_t need)
+{
+	dbj_log_record_* old_ = batch_tls_.text;
+	if (old_ && old_->capacity - batch_tls_.used >= need) return true;
+
+	size_t capacity_ = old_ ? old_->capacity * 2 : pool_record_sizes_[DBJ_LOG_POOL_CLASSES - 2];
+	while (capacity_ - batch_tls_.used < need) capacity_ *= 2;
+
+	dbj_log_record_* rec = record_alloc_(capacity_);
+	if (!rec) return false;
+
+	if (old_) {
+		memcpy(dbj_log_record_data(rec), dbj_log_record_data(old_), batch_tls_.used);
+		record_free_(old_);
+	}
+	batch_tls_.text = rec;
+	return true;
+}
+
+static void batch_commit_(void)
+{
+	if (batch_tls_.count == 0) return;
+
+	log_message_ messages_[DBJ_LOG_BATCH_LINES];
+	const char* text_ = dbj_log_record_data(batch_tls_.text);
+
+	for (size_t j = 0; j < batch_tls_.count; ++j) {
+		const batch_line_* bl = &batch_tls_.lines[j];
+		const log_message_ message_ = { bl->file, bl->line, text_ + bl->offset, bl->len };
+		messages_[j] = message_;
+	}
+
+	const long long start_ = PROFILE.on ? clock_ticks_() : 0;
+	const size_t written_ = log_emit_(batch_tls_.level, messages_, batch_tls_.count, batch_tls_.weight, batch_tls_.site);
+
+	if (PROFILE.on)
+		profile_note_(batch_tls_.file, batch_tls_.line, (long long)batch_tls_.count, written_,
+			batch_tls_.ticks + clock_ticks_() - start_);
+
+	batch_tls_.count = 0;
+	batch_tls_.used = 0;
+	batch_tls_.ticks = 0;
+}
+
+void dbj_simple_log_batch_begin(int level, const char* file, int line)
+{
+	/* nested, lines join the outer batch, logged at its end, at its level */
+	if (batch_tls_.open) {
+		batch_tls_.nested += 1;
+		return;
+	}
+
+	batch_tls_.open = true;
+	batch_tls_.level = level;
+	batch_tls_.file = file;
+	batch_tls_.line = line;
+	batch_tls_.ticks = 0;
+	batch_tls_.site = NULL;
+	batch_tls_.weight = log_admit_(level, file, line, &batch_tls_.site);
+	batch_tls_.used = 0;
+	batch_tls_.count = 0;
+}
+
+void dbj_simple_log_batch_line(const char* file, int line, const char* fmt, ...)
+{
+	DBJ_ASSERT(batch_tls_.open);
+	if (!batch_tls_.open || batch_tls_.weight == 0) return;
+
+	/* full, what is in is logged and the batch goes on */
+	if (batch_tls_.count == DBJ_LOG_BATCH_LINES) batch_commit_();
+
+	const long long start_ = PROFILE.on ? clock_ticks_() : 0;
+
+	va_list args;
+	va_start(args, fmt);
+
+	int len = fmt_truncated_;
+	size_t need_ = 256;
+	while (len == fmt_truncated_ && batch_reserve_(need_))
+	{
+		va_list try_;
+		va_copy(try_, args);
+		len = fast_format_(dbj_log_record_data(batch_tls_.text) + batch_tls_.used,
+			batch_tls_.text->capacity - batch_tls_.used, fmt, try_);
+		va_end(try_);
+		need_ = (batch_tls_.text->capacity - batch_tls_.used) * 2;
+	}
+
+	/* not for the fast format, formatted elsewhere and copied in */
+	if (len == fmt_unsupported_) {
+		dbj_log_record_* rec = record_format_(fmt, args);
+		if (rec && batch_reserve_(rec->length)) {
+			memcpy(dbj_log_record_data(batch_tls_.text) + batch_tls_.used, dbj_log_record_data(rec), rec->length);
+			len = (int)rec->length;
+		}
+		record_free_(rec);
+	}
+	va_end(args);
+
+	if (len < 0) {
+		DBJ_PERROR;
+		return;
+	}
+
+	batch_line_* bl = &batch_tls_.lines[batch_tls_.count++];
+	bl->file = file;
+	bl->line = line;
+	bl->offset = batch_tls_.used;
+	bl->len = (size_t)len;
+	batch_tls_.used += (size_t)len;
+
+	if (PROFILE.on) batch_tls_.ticks += clock_ticks_() - start_;
+}
+
+void dbj_simple_log_batch_end(void)
+{
+	DBJ_ASSERT(batch_tls_.open);
+	if (!batch_tls_.open) return;
+
+	/* the outer batch goes on */
+	if (batch_tls_.nested) {
+		batch_tls_.nested -= 1;
+		return;
+	}
+
+	batch_commit_();
+	record_free_(batch_tls_.text);
+	batch_tls_.text = NULL;
+	batch_tls_.open = false;
+}
+
+/* DBJ_LOG_PROFILE report, here as it logs through log_emit_ */
+/* one report line, its own record, NULL on no memory */
+static dbj_log_record_* profile_line_(const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	dbj_log_record_* rec = record_format_(fmt, args);
+	va_end(args);
+	return rec;
+}
+
+void dbj_log_profile_report(unsigned top)
+{
+	if (!PROFILE.on) return;
+
+	static profile_row_ rows_[DBJ_LOG_PROFILE_SITES];
+	static SRWLOCK reporting_ = SRWLOCK_INIT;
+
+	AcquireSRWLockExclusive(&reporting_);
+
+	/* snapshot, other threads go on adding, the report adds up anyway */
+	unsigned count_ = 0;
+	long long ticks_ = 0, bytes_ = 0;
+	const long long lost_ = PROFILE.lost;
+	for (int j = 0; j < DBJ_LOG_PROFILE_SITES; ++j) {
+		const profile_site_* site = PROFILE.sites + j;
+		const LONG line_ = site->at.line;
+		if (line_ <= 0) continue;
+		const profile_row_ row_ = { site->at.file, line_, site->calls, site->bytes, site->ticks };
+		if (!row_.calls) continue;
+		rows_[count_++] = row_;
+		ticks_ += row_.ticks;
+		bytes_ += row_.bytes;
+	}
+
+	qsort(rows_, count_, sizeof(rows_[0]), profile_order_);
+	if (top == 0 || top > count_) top = count_;
+
+	/*
+	all the lines in one log_emit_, as the batch would do
+	not the batch API, the report may be asked for inside the caller's batch
+	*/
+	sample_site_* site_ = NULL;
+	const unsigned weight_ = log_admit_(DBJ_LOG_INFO, __FILE__, __LINE__, &site_);
+	dbj_log_record_** lines_ = (dbj_log_record_**)calloc((size_t)top + 1, sizeof(dbj_log_record_*));
+	log_message_* messages_ = (log_message_*)calloc((size_t)top + 1, sizeof(log_message_));
+	size_t count_lines_ = 0;
+
+	if (weight_ && lines_ && messages_) {
+		dbj_log_record_* rec = profile_line_("logging cost, top %u of %u call sites, %lld us and %lld bytes in total, %lld calls not counted",
+			top, count_, clock_ns_(ticks_) / 1000, bytes_, lost_);
+		if (rec) {
+			const log_message_ message_ = { __FILE__, __LINE__, dbj_log_record_data(rec), rec->length };
+			messages_[count_lines_] = message_;
+			lines_[count_lines_++] = rec;
+		}
+
+		for (unsigned j = 0; j < top; ++j) {
+			const profile_row_* row = rows_ + j;
+			const long long ns_ = clock_ns_(row->ticks);
+			rec = profile_line_("%s(%ld) calls %lld, bytes %lld, time %lld us, %lld ns per call, %lld%% of the time",
+				row->file, row->line, row->calls, row->bytes, ns_ / 1000, ns_ / row->calls,
+				ticks_ ? row->ticks * 100 / ticks_ : 0ll);
+			if (!rec) continue;
+			const log_message_ message_ = { row->file, (int)row->line, dbj_log_record_data(rec), rec->length };
+			messages_[count_lines_] = message_;
+			lines_[count_lines_++] = rec;
+		}
+
+		if (count_lines_) (void)log_emit_(DBJ_LOG_INFO, messages_, count_lines_, weight_, site_);
+	}
+
+	for (size_t j = 0; j < count_lines_; ++j) record_free_(lines_[j]);
+	free(lines_);
+	free(messages_);
+
+	ReleaseSRWLockExclusive(&reporting_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// hex dump and base64 of the binary data
+///
+/// whole dump is one record, thus one lock and one write per target
+/// first line is the usual prefix with the label, then the dump lines
+/// 00000000  48 65 6C 6C 6F 2C 20 77  6F 72 6C 64 21 0A 00 01  |Hello, world!...|
+/// or the single base64 field after the label
+/// not more than DUMP.limit bytes are dumped, 0 is no limit
+
+static struct {
+	size_t volatile limit;
+} DUMP = { DBJ_LOG_DUMP_MAX };
+
+#define dump_row_ 16
+/* offset, two blanks, 16 x 3 hex, blank, blank, |16 chars|, new line */
+#define dump_row_len_ (8 + 2 + dump_row_ * 3 + 1 + 1 + 1 + dump_row_ + 1 + 1)
+/* the label line and the rows of DBJ_LOG_DUMP_MAX bytes, logged at once */
+#define dump_messages_ ((DBJ_LOG_DUMP_MAX + dump_row_ - 1) / dump_row_ + 1)
+static_assert(dump_messages_ * sizeof(log_message_) <= 64 * 1024,
+	"rows of the DBJ_LOG_DUMP_MAX dump are on the stack, use dbj_log_dump_limit for the bigger ones");
+
+void dbj_log_dump_limit(size_t bytes)
+{
+	DUMP.limit = bytes;
+}
+
+/*
+hex pairs of 16 bytes into hex[32], printable chars into text[16], '.' for the rest
+SSE2: nibbles are turned to digits, 16 at once
+*/
+static void dump_encode_(const unsigned char* src, char* hex, char* text)
+{
+#ifdef DBJ_LOG_SSE2
+	const __m128i bytes_ = _mm_loadu_si128((const __m128i*)src);
+	const __m128i low_mask_ = _mm_set1_epi8(0x0F);
+	const __m128i hi_ = _mm_and_si128(_mm_srli_epi16(bytes_, 4), low_mask_);
+	const __m128i lo_ = _mm_and_si128(bytes_, low_mask_);
+
+	/* '0' + n, and 7 more above 9, for 'A' to 'F' */
+	const __m128i nine_ = _mm_set1_epi8(9);
+	const __m128i zero_ = _mm_set1_epi8('0');
+	const __m128i seven_ = _mm_set1_epi8(7);
+	const __m128i hi_digits_ = _mm_add_epi8(_mm_add_epi8(hi_, zero_), _mm_and_si128(_mm_cmpgt_epi8(hi_, nine_), seven_));
+	const __m128i lo_digits_ = _mm_add_epi8(_mm_add_epi8(lo_, zero_), _mm_and_si128(_mm_cmpgt_epi8(lo_, nine_), seven_));
+
+	_mm_storeu_si128((__m128i*)hex, _mm_unpacklo_epi8(hi_digits_, lo_digits_));
+	_mm_storeu_si128((__m128i*)(hex + 16), _mm_unpackhi_epi8(hi_digits_, lo_digits_));
+
+	/* signed compare, 0x80 and above are negative thus not printable */
+	const __m128i printable_ = _mm_and_si128(
+		_mm_cmpgt_epi8(bytes_, _mm_set1_epi8(0x1F)), _mm_cmplt_epi8(bytes_, _mm_set1_epi8(0x7F)));
+	_mm_storeu_si128((__m128i*)text, _mm_or_si128(
+		_mm_and_si128(printable_, bytes_), _mm_andnot_si128(printable_, _mm_set1_epi8('.'))));
+#else
+	static const char digits_[] = "0123456789ABCDEF";
+	for (int j = 0; j < dump_row_; ++j) {
+		hex[2 * j] = digits_[src[j] >> 4];
+		hex[2 * j + 1] = digits_[src[j] & 0xF];
+		text[j] = (src[j] > 0x1F && src[j] < 0x7F) ? (char)src[j] : '.';
+	}
+#endif // DBJ_LOG_SSE2
+}
+
+/* one dump line, n is 1 .. 16, returns the length, no new line */
+static size_t dump_row_put_(char* dst, size_t offset, const unsigned char* src, size_t n)
+{
+	unsigned char bytes_[dump_row_] = { 0 };
+	char hex_[dump_row_ * 2], text_[dump_row_];
+	memcpy(bytes_, src, n);
+	dump_encode_(bytes_, hex_, text_);
+
+	char* w = dst;
+	memset(w, '0', 8);
+	char digits_[16];
+	int len_ = u64_to_hex_(offset, digits_ + sizeof(digits_), true);
+	if (len_ > 8) len_ = 8;
+	memcpy(w + 8 - len_, digits_ + sizeof(digits_) - len_, (size_t)len_);
+	w += 8;
+	*w++ = ' ';
+
+	for (size_t j = 0; j < dump_row_; ++j) {
+		if (j == dump_row_ / 2) *w++ = ' ';
+		if (j < n) {
+			w[0] = ' ';
+			w[1] = hex_[2 * j];
+			w[2] = hex_[2 * j + 1];
+		}
+		else {
+			memset(w, ' ', 3);
+		}
+		w += 3;
+	}
+
+	*w++ = ' ';
+	*w++ = ' ';
+	*w++ = '|';
+	memcpy(w, text_, n);
+	w += n;
+	*w++ = '|';
+	return (size_t)(w - dst);
+}
+
+static const char base64_digits_[] =
+"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/* dst must have 4 * ((n + 2) / 3) chars, returns the length */
+static size_t base64_put_(char* dst, const unsigned char* src, size_t n)
+{
+	char* w = dst;
+	size_t j = 0;
+	for (; j + 3 <= n; j += 3) {
+		const unsigned triple_ = ((unsigned)src[j] << 16) | ((unsigned)src[j + 1] << 8) | src[j + 2];
+		w[0] = base64_digits_[(triple_ >> 18) & 63];
+		w[1] = base64_digits_[(triple_ >> 12) & 63];
+		w[2] = base64_digits_[(triple_ >> 6) & 63];
+		w[3] = base64_digits_[triple_ & 63];
+		w += 4;
+	}
+	if (j < n) {
+		const unsigned triple_ = ((unsigned)src[j] << 16) | ((j + 1 < n) ? ((unsigned)src[j + 1] << 8) : 0u);
+		w[0] = base64_digits_[(triple_ >> 18) & 63];
+		w[1] = base64_digits_[(triple_ >> 12) & 63];
+		w[2] = (j + 1 < n) ? base64_digits_[(triple_ >> 6) & 63] : '=';
+		w[3] = '=';
+		w += 4;
+	}
+	return (size_t)(w - dst);
+}
+
+/* dump of data into the record, NULL on no memory */
+static dbj_log_record_* dump_format_(const void* data, size_t len, const char* label, int kind)
+{
+	const unsigned char* bytes_ = (const unsigned char*)data;
+	const size_t limit_ = DUMP.limit;
+	const size_t shown_ = (limit_ && len > limit_) ? limit_ : len;
+	const size_t label_len_ = label ? strlen(label) : 0;
+
+	const size_t body_ = (kind == DBJ_LOG_DUMP_BASE64) ?
+		8 + 4 * ((shown_ + 2) / 3) : ((shown_ + dump_row_ - 1) / dump_row_) * dump_row_len_;
+
+	/* label, byte counts and the truncation note */
+	dbj_log_record_* rec = record_alloc_(label_len_ + 64 + body_);
+	if (!rec) return NULL;
+
+	char* const start_ = dbj_log_record_data(rec);
+	char* w = start_;
+	if (label_len_) {
+		memcpy(w, label, label_len_);
+		w += label_len_;
+		*w++ = ':';
+		*w++ = ' ';
+	}
+
+	char digits_[24];
+	int n = u64_to_dec_(len, digits_ + sizeof(digits_));
+	w = line_put_(w, digits_ + sizeof(digits_) - n, (size_t)n);
+	w = line_put_(w, " bytes", 6);
+
+	if (shown_ < len) {
+		n = u64_to_dec_(shown_, digits_ + sizeof(digits_));
+		w = line_put_(w, ", first ", 8);
+		w = line_put_(w, digits_ + sizeof(digits_) - n, (size_t)n);
+		w = line_put_(w, " shown", 6);
+	}
+
+	if (kind == DBJ_LOG_DUMP_BASE64) {
+		w = line_put_(w, " base64=", 8);
+		w += base64_put_(w, bytes_, shown_);
+	}
+	else {
+		for (size_t offset_ = 0; offset_ < shown_; offset_ += dump_row_) {
+			const size_t row_ = (shown_ - offset_) < dump_row_ ? (shown_ - offset_) : dump_row_;
+			*w++ = '\n';
+			w += dump_row_put_(w, offset_, bytes_ + offset_, row_);
+		}
+	}
+
+	rec->length = (size_t)(w - start_);
+	DBJ_ASSERT(rec->length < rec->capacity);
+	*w = '\0';
+	return rec;
+}
+
+void dbj_simple_log_dump(int level, const char* file, int line,
+	const void* data, size_t len, const char* label, int kind)
+{
+	sample_site_* site_ = NULL;
+	const unsigned weight_ = log_admit_(level, file, line, &site_);
+	if (weight_ == 0) return;
+
+	const long long start_ = PROFILE.on ? clock_ticks_() : 0;
+	if (!data) len = 0;
+
+	dbj_log_record_* rec = dump_format_(data, len, label, kind);
+	if (!rec) {
+		DBJ_PERROR;
+		return;
+	}
+
+	/*
+	each row is the line of its own, as the batch lines are
+	all in one log_emit_, one lock and one write
+	rows of the default size dump are on the stack, more than that after dbj_log_dump_limit are on the heap
+	*/
+	log_message_ stack_[dump_messages_];
+	const char* const end_ = dbj_log_record_data(rec) + rec->length;
+
+	size_t rows_ = 1;
+	for (const char* row_ = dbj_log_record_data(rec); (row_ = (const char*)memchr(row_, '\n', (size_t)(end_ - row_))) != NULL; ++row_)
+		rows_ += 1;
+
+	log_message_* messages_ = rows_ <= dump_messages_ ? stack_ : (log_message_*)malloc(rows_ * sizeof(log_message_));
+	if (!messages_) {
+		DBJ_PERROR;
+		record_free_(rec);
+		return;
+	}
+
+	size_t count_ = 0;
+	for (const char* row_ = dbj_log_record_data(rec); row_ < end_; )
+	{
+		const char* eol_ = (const char*)memchr(row_, '\n', (size_t)(end_ - row_));
+		if (!eol_) eol_ = end_;
+
+		const log_message_ message_ = { file, line, row_, (size_t)(eol_ - row_) };
+		messages_[count_++] = message_;
+		row_ = eol_ + 1;
+	}
+	const size_t written_ = log_emit_(level, messages_, count_, weight_, site_);
+
+	if (messages_ != stack_) free(messages_);
+	record_free_(rec);
+
+	if (PROFILE.on)
+		profile_note_(file, line, 1, written_, clock_ticks_() - start_);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// scope timing
+///
+/// per scope site, file and line of the begin, durations are aggregated
+/// lock free: interlocked counters, CAS for min and max
+/// histogram has 4 buckets per power of two of nanoseconds, good enough for p99
+
+#define scope_buckets_ 164
+
+typedef struct scope_stats_ {
+	log_site_ at;
+	const char* name;
+	int level;
+	volatile LONG64 count;
+	volatile LONG64 sum;
+	volatile LONG64 min;
+	volatile LONG64 max;
+	volatile LONG buckets[scope_buckets_];
+} scope_stats_;
+
+static struct {
+	volatile LONG64 dumped_at;
+	scope_stats_ sites[DBJ_LOG_SCOPE_SITES];
+} SCOPE;
+
+static int scope_bucket_(unsigned long long ns)
+{
+	if (ns < 4) return (int)ns;
+
+	unsigned long msb = 0;
+	_BitScanReverse64(&msb, ns);
+	const int j = ((int)msb - 1) * 4 + (int)((ns >> (msb - 2)) & 3);
+	return j < scope_buckets_ ? j : scope_buckets_ - 1;
+}
+
+/* the middle of the bucket */
+static long long scope_bucket_ns_(int j)
+{
+	if (j < 4) return j;
+	const int msb = j / 4 + 1;
+	const long long low = (long long)(4 + j % 4) << (msb - 2);
+	return low + ((1ll << (msb - 2)) / 2);
+}
+
+static void scope_stats_init_(log_site_* at, const void* param)
+{
+	scope_stats_* site = (scope_stats_*)at;
+	const dbj_log_scope* scope = (const dbj_log_scope*)param;
+	site->name = scope->name;
+	site->level = scope->level;
+	site->min = LLONG_MAX;
+}
+
+/* NULL if the table is full */
+static scope_stats_* scope_stats_find_(const dbj_log_scope* scope)
+{
+	static_assert((DBJ_LOG_SCOPE_SITES & (DBJ_LOG_SCOPE_SITES - 1)) == 0,
+		"DBJ_LOG_SCOPE_SITES must be a power of two");
+	static_assert(offsetof(scope_stats_, at) == 0, "log_site_ must be the first");
+
+	return (scope_stats_*)log_site_find_(SCOPE.sites, sizeof(scope_stats_), DBJ_LOG_SCOPE_SITES,
+		scope->file, scope->line, true, scope_stats_init_, scope);
+}
+
+static void scope_stats_add_(scope_stats_* site, long long ns)
+{
+	InterlockedIncrement64(&site->count);
+	InterlockedExchangeAdd64(&site->sum, ns);
+	InterlockedIncrement(&site->buckets[scope_bucket_((unsigned long long)ns)]);
+
+	LONG64 seen_ = site->min;
+	while (ns < seen_) {
+		const LONG64 was_ = InterlockedCompareExchange64(&site->min, ns, seen_);
+		if (was_ == seen_) break;
+		seen_ = was_;
+	}
+	seen_ = site->max;
+	while (ns > seen_) {
+		const LONG64 was_ = InterlockedCompareExchange64(&site->max, ns, seen_);
+		if (was_ == seen_) break;
+		seen_ = was_;
+	}
+}
+
+dbj_log_scope dbj_log_scope_begin(int level, const char* name, const char* file, int line)
+{
+	dbj_log_scope scope_ = { level, name ? name : "", file, line, 0 };
+	/* last, not to time the above */
+	scope_.start = clock_ticks_();
+	return scope_;
+}
+
+void dbj_log_scope_end(dbj_log_scope* scope)
+{
+	const long long end_ = clock_ticks_();
+	const long long ns_ = clock_ns_(end_ - scope->start);
+
+	scope_stats_* site = scope_stats_find_(scope);
+	if (site) scope_stats_add_(site, ns_);
+
+	if (ns_ < 10000)
+		dbj_simple_log_log(scope->level, scope->file, scope->line, "%s took %lld ns", scope->name, ns_);
+	else
+		dbj_simple_log_log(scope->level, scope->file, scope->line, "%s took %lld us", scope->name, ns_ / 1000);
+
+	if (DBJ_LOG_SCOPE_DUMP_MS > 0) {
+		const LONG64 now_ = (LONG64)GetTickCount64();
+		const LONG64 last_ = SCOPE.dumped_at;
+		if (!last_)
+			InterlockedCompareExchange64(&SCOPE.dumped_at, now_, 0);
+		else if (now_ - last_ >= DBJ_LOG_SCOPE_DUMP_MS
+			&& InterlockedCompareExchange64(&SCOPE.dumped_at, now_, last_) == last_)
+			dbj_log_scope_dump();
+	}
+}
+
+void dbj_log_scope_dump(void)
+{
+	for (int j = 0; j < DBJ_LOG_SCOPE_SITES; ++j)
+	{
+		const scope_stats_* site = SCOPE.sites + j;
+		const long long count_ = site->count;
+		if (site->at.line <= 0 || !count_) continue;
+
+		/* not exact, other threads might be adding */
+		long long p99_ = site->max, seen_ = 0;
+		for (int b = 0; b < scope_buckets_; ++b) {
+			seen_ += site->buckets[b];
+			if (seen_ * 100 >= count_ * 99) {
+				p99_ = scope_bucket_ns_(b);
+				break;
+			}
+		}
+		if (p99_ > site->max) p99_ = site->max;
+
+		dbj_simple_log_log(site->level, site->at.file, site->at.line,
+			"%s count %lld, min %lld, avg %lld, max %lld, p99 %lld ns",
+			site->name, count_, site->min, site->sum / count_, site->max, p99_);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/*
+no more system(" ") here, that was spawning the shell just to have the
+side effect of VT mode on, now the console is asked directly
+*/
+static bool enable_vt_mode(void)
+{
+	// console output goes to stderr
+	HANDLE hOut = GetStdHandle(STD_ERROR_HANDLE);
+	if (hOut == INVALID_HANDLE_VALUE || hOut == NULL)
+	{
+		return false;
+	}
+
+	// this will fail if this app output is 
+	// redirected to a file
+	DWORD dwMode = 0;
+	if (!GetConsoleMode(hOut, &dwMode))
+	{
+		return false;
+	}
+	/*
+	Virtual terminal mode is available in the console starting with
+	Windows 10.0.10586. It's not supported by the OS if setting
+	the mode fails with ERROR_INVALID_PARAMETER (87). Also,
+	it's only implemented in the new console. With the legacy
+	console selected in Windows 10, enabling VT mode may succeed,
+	but it won't actually enable VT support.
+	*/
+#ifndef	ENABLE_VIRTUAL_TERMINAL_PROCESSING
+	return false;
+#else
+	if (dwMode & ENABLE_VIRTUAL_TERMINAL_PROCESSING) return true;
+
+	dwMode |= ENABLE_VIRTUAL_TERMINAL_PROCESSING;
+	if (!SetConsoleMode(hOut, dwMode))
+	{
+		return false;
+	}
+	return true;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// typedef void (*log_lock_function_ptr)(void* user_data, int lock);
+
+/*
+this actually might be NOT slower than using some global CRITICAL_SECTION
+and entering/deleting it only once ... why not measuring it?
+*/
+static void  default_protector_function(bool lock)
+{
+	// Think: this is one per process
+	// it was the critical section made and deleted on each call
+	// thus protecting nothing
+	if (lock)
+		AcquireSRWLockExclusive(&log_lock_);
+	else
+		ReleaseSRWLockExclusive(&log_lock_);
+}
+
+/*
+if in need of some kindergarten enum masks handling refresher please look here
+https://stackoverflow.com/a/12255836/10870835
+*/
+#undef  DBJ_LOG_IS_BIT
+#define DBJ_LOG_IS_BIT(S_, B_) ( 0 != ((S_) & (B_)) )
+
+/*
+DBJ_LOG_PREALLOCATE bytes are reserved for the log file
+on the thread pool, off the startup path
+the work is waited for before the file is closed, it uses the file handle
+*/
+static PTP_WORK log_file_preallocate_work_ = NULL;
+
+static void CALLBACK log_file_preallocate_(PTP_CALLBACK_INSTANCE instance_, PVOID fd_, PTP_WORK work_)
+{
+	(void)instance_; (void)work_;
+	FILE_ALLOCATION_INFO info_;
+	info_.AllocationSize.QuadPart = DBJ_LOG_PREALLOCATE;
+
+	HANDLE file_ = (HANDLE)_get_osfhandle((int)(intptr_t)fd_);
+	if (file_ != INVALID_HANDLE_VALUE)
+		(void)SetFileInformationByHandle(file_, FileAllocationInfo, &info_, sizeof(info_));
+}
+
+static bool dbj_log_setup
+(/*DBJ_LOG_SETUP_ENUM*/ const int setup, const char* app_full_path)
+{
+	const bool file_log_ = DBJ_LOG_IS_BIT(setup, DBJ_LOG_TO_FILE);
+
+	LOCAL.full_time_stamp = DBJ_LOG_IS_BIT(setup, DBJ_LOG_FULL_TIMESTAMP);
+	LOCAL.file_line_show = DBJ_LOG_IS_BIT(setup, DBJ_LOG_FILELINE_SHOW);
+	LOCAL.no_console = DBJ_LOG_IS_BIT(setup, DBJ_LOG_NO_CONSOLE);
+	LOCAL.lock = DBJ_LOG_IS_BIT(setup, DBJ_LOG_MT) ? default_protector_function : NULL;
+	LOCAL.tsc_stamp = DBJ_LOG_IS_BIT(setup, DBJ_LOG_TSC_TIMESTAMP);
+	PROFILE.on = DBJ_LOG_IS_BIT(setup, DBJ_LOG_PROFILE);
+
+	/* before any line, unless some scope has made it already */
+	if (LOCAL.tsc_stamp) clock_ready_();
+
+	prefix_templates_make_();
+
+	if (!LOCAL.no_console && DBJ_LOG_IS_BIT(setup, DBJ_LOG_CONSOLE_ASYNC))
+		(void)console_open_();
+
+	const bool net_log_ = DBJ_LOG_IS_BIT(setup, DBJ_LOG_NET) && net_open_(app_full_path);
+
+	if (LOCAL.no_console)
+		if (!file_log_ && !net_log_)
+		{
+			DBJ_VERIFY(LOCAL.no_console || file_log_);
+			// run-time feeble attempt
+			// WARNING: DBJ_LOG_NO_CONSOLE is set, but no log file is requested?
+			DBJ_PERROR;
+		}
+
+	// caller does not want any kind of local log file
+	if (!file_log_)
+		// app_full_path ignored here
+	{
+		return true;
+	}
+
+	// many processes one file, ring collector owns the file
+	if (DBJ_LOG_IS_BIT(setup, DBJ_LOG_SHARED_RING))
+	{
+		dbj_fhandle ring_file_ = dbj_fhandle_make(app_full_path);
+		set_log_file_name(ring_file_.name);
+		return ring_worker_start_(ring_file_.name);
+	}
+
+	// compressed frames, the worker owns the file
+	if (DBJ_LOG_IS_BIT(setup, DBJ_LOG_COMPRESS))
+	{
+		dbj_fhandle frames_file_ = dbj_fhandle_make(app_full_path);
+		strncat_s(frames_file_.name, dbj_fhandle_max_name_len, ".lz4", _TRUNCATE);
+		set_log_file_name(frames_file_.name);
+		return compress_open_(frames_file_.name);
+	}
+
+	// make it once
+	static dbj_fhandle log_file_handle_shared_;
+
+	if (dbj_fhandle_is_empty(&log_file_handle_shared_))
+	{
+		log_file_handle_shared_ = dbj_fhandle_make(app_full_path);
+		// records are never appended to the text lines of some other setup
+		// and dbj_log_query knows the file by its name
+		if (DBJ_LOG_IS_BIT(setup, DBJ_LOG_CRC))
+			strncat_s(log_file_handle_shared_.name, dbj_fhandle_max_name_len, ".crc", _TRUNCATE);
+	}
+
+	// assure file handle is propely open and set
+	errno_t status = dbj_fhandle_assure(&log_file_handle_shared_);
+
+	DBJ_ASSERT(status == 0);
+
+	// index offsets and record lengths are the bytes given to fwrite
+	// text mode would make each \n into \r\n on the disk
+	// set on the descriptor, before the stream exists and anything is written
+	if (status == 0 && (DBJ_LOG_IS_BIT(setup, DBJ_LOG_CRC) || DBJ_LOG_IS_BIT(setup, DBJ_LOG_FILE_INDEX)))
+		(void)_setmode(log_file_handle_shared_.file_descriptor, _O_BINARY);
+
+	if (DBJ_LOG_PREALLOCATE > 0 && status == 0 && !log_file_preallocate_work_) {
+		log_file_preallocate_work_ = CreateThreadpoolWork(log_file_preallocate_,
+			(PVOID)(intptr_t)log_file_handle_shared_.file_descriptor, NULL);
+		if (log_file_preallocate_work_) SubmitThreadpoolWork(log_file_preallocate_work_);
+	}
+
+	log_set_fp(
+		dbj_fhandle_file_ptr(&log_file_handle_shared_), log_file_handle_shared_.name
+	);
+
+	// records with the length and CRC32C
+	if (DBJ_LOG_IS_BIT(setup, DBJ_LOG_CRC) && LOCAL.fp)
+		LOCAL.crc = true;
+
+	if (DBJ_LOG_IS_BIT(setup, DBJ_LOG_FILE_INDEX))
+		index_open_(log_file_handle_shared_.name);
+
+	// we keep it in user_data void * so we decouple from dbj_fhandle
+	LOCAL.user_data = (&log_file_handle_shared_);
+
+	return true;
+} // dbj_log_setup
+
+#undef DBJ_LOG_IS_BIT
+
+/* fast formatting against the CRT, mismatch is logged */
+static int fast_format_check_(const char* fmt, ...)
+{
+	char fast_[256], crt_[256];
+	va_list args, crt_args;
+	va_start(args, fmt);
+	va_copy(crt_args, args);
+	const int fast_len = fast_format_(fast_, sizeof(fast_), fmt, args);
+	const int crt_len = vsnprintf(crt_, sizeof(crt_), fmt, crt_args);
+	va_end(crt_args);
+	va_end(args);
+
+	if (fast_len == crt_len && 0 == strcmp(fast_, crt_)) return 0;
+
+	dbj_log_error("fast format '%s' gives '%s', CRT gives '%s'", fmt, fast_len < 0 ? "" : fast_, crt_);
+	return 1;
+}
+
+static int fast_format_va_(char* buf, size_t cap, const char* fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	const int len = fast_format_(buf, cap, fmt, args);
+	va_end(args);
+	return len;
+}
+
+/*
+wide strings are UTF-8 here, CRT uses the current code page
+thus they are checked against the known bytes
+*/
+static int wide_format_check_(void)
+{
+	/* ASCII long enough for SSE2, e acute, CJK, emoji as the pair, lone surrogate */
+	static const wchar_t wide_[] = { 'A','B','C','D','E','F','G','H','I','J', 0x00E9, 0x4E2D, 0xD83D, 0xDE00, 0xD800, 'z', 0 };
+	static const char utf8_[] = "[ABCDEFGHIJ" "\xC3\xA9" "\xE4\xB8\xAD" "\xF0\x9F\x98\x80" "\xEF\xBF\xBD" "z]";
+
+	char buf_[128];
+	int mismatches = 0;
+
+	int len = fast_format_va_(buf_, sizeof(buf_), "[%ls]", wide_);
+	if (len < 0 || 0 != strcmp(buf_, utf8_)) {
+		dbj_log_error("fast format '%%ls' does not give the expected UTF-8");
+		++mismatches;
+	}
+
+	len = fast_format_va_(buf_, sizeof(buf_), "|%6S|%-6ls|%.2ls|%lc", L"ab", L"ab", L"éx", (int)L'q');
+	if (len < 0 || 0 != strcmp(buf_, "|    ab|ab    |\xC3\xA9|q")) {
+		dbj_log_error("fast format of the wide strings gives '%s'", len < 0 ? "" : buf_);
+		++mismatches;
+	}
+
+	/*
+	precision is in bytes, whole characters only: a, e acute, CJK, emoji
+	the same in the roomy output and in the one just big enough
+	*/
+	{
+		static const wchar_t mixed_[] = { 'a', 0x00E9, 0x4E2D, 0xD83D, 0xDE00, 0 };
+		static const struct { const char* fmt; const char* utf8; } cases_[] = {
+			{ "[%.0ls]", "[]" },
+			{ "[%.2ls]", "[a]" },
+			{ "[%.3ls]", "[a\xC3\xA9]" },
+			{ "[%.5ls]", "[a\xC3\xA9]" },
+			{ "[%.6ls]", "[a\xC3\xA9\xE4\xB8\xAD]" },
+			{ "[%.9ls]", "[a\xC3\xA9\xE4\xB8\xAD]" },
+			{ "[%.10ls]", "[a\xC3\xA9\xE4\xB8\xAD\xF0\x9F\x98\x80]" },
+			{ "[%-8.5ls]", "[a\xC3\xA9     ]" },
+		};
+		for (size_t j = 0; j < sizeof(cases_) / sizeof(cases_[0]); ++j) {
+			const size_t exact_ = strlen(cases_[j].utf8) + 1;
+			const int roomy_ = fast_format_va_(buf_, sizeof(buf_), cases_[j].fmt, mixed_);
+			const bool roomy_good_ = roomy_ >= 0 && 0 == strcmp(buf_, cases_[j].utf8);
+			const int tight_ = fast_format_va_(buf_, exact_, cases_[j].fmt, mixed_);
+			if (!roomy_good_ || tight_ < 0 || 0 != strcmp(buf_, cases_[j].utf8)) {
+				dbj_log_error("fast format '%s' of the wide string gives '%s'", cases_[j].fmt, tight_ < 0 ? "" : buf_);
+				++mismatches;
+			}
+		}
+	}
+
+	/* with the specs snprintf does, UTF-8 still */
+	len = fast_format_va_(buf_, sizeof(buf_), "%ls|%.1e|%#o|%hhd|%I64d|%wc", wide_ + 10, 1.5, 8u, 300, -5LL, (int)L'w');
+	if (len < 0 || 0 != strcmp(buf_, "\xC3\xA9" "\xE4\xB8\xAD" "\xF0\x9F\x98\x80" "\xEF\xBF\xBD" "z|1.5e+00|010|44|-5|w")) {
+		dbj_log_error("fast format of the wide strings, with the rest, gives '%s'", len < 0 ? "" : buf_);
+		++mismatches;
+	}
+	return mismatches;
+}
+
+/* dump lines and base64, against the known output */
+static int dump_check_(void)
+{
+	static const char bytes_[] = "Hello, world!\n\x00\x01\x7F\x80\xFF";
+	static const char hex_[] = "hi: 18 bytes\n"
+		"00000000  48 65 6C 6C 6F 2C 20 77  6F 72 6C 64 21 0A 00 01  |Hello, world!...|\n"
+		"00000010  7F 80                                             |..|";
+	static const char base64_[] = "17 bytes base64=SGVsbG8sIHdvcmxkIQoAAX8=";
+
+	int mismatches = 0;
+	dbj_log_record_* rec = dump_format_(bytes_, 18, "hi", DBJ_LOG_DUMP_HEX);
+	if (rec && 0 != strcmp(dbj_log_record_data(rec), hex_)) {
+		dbj_log_error("hex dump is not as expected");
+		++mismatches;
+	}
+	record_free_(rec);
+
+	rec = dump_format_(bytes_, 17, NULL, DBJ_LOG_DUMP_BASE64);
+	if (rec && 0 != strcmp(dbj_log_record_data(rec), base64_)) {
+		dbj_log_error("base64 dump is not as expected");
+		++mismatches;
+	}
+	record_free_(rec);
+	return mismatches;
+}
+
+static int fast_format_conformance_(void)
+{
+	int mismatches = 0;
+	mismatches += fast_format_check_("%d %i %d", 0, -1, -2147483647 - 1);
+	mismatches += fast_format_check_("%lld %llu", -9223372036854775807LL - 1, 18446744073709551615ULL);
+	mismatches += fast_format_check_("%u %lu %zu", 4000000000u, 12ul, (size_t)77);
+	mismatches += fast_format_check_("%x %X %#x %#X %08x %-8x| %.5x %.0x", 255u, 255u, 255u, 0u, 0xabu, 0xabu, 0x12u, 0u);
+	mismatches += fast_format_check_("%5d|%-5d|%05d|%+d|% d|%.3d|%8.3d|%-+6d|%0+6d", 42, 42, 42, 42, 42, 7, 7, 7, -7);
+	mismatches += fast_format_check_("%10.4d|%-10.4d|%010.4d|%.0d|", -12, 12, 12, 0);
+	mismatches += fast_format_check_("%s|%10s|%-10s|%.2s|%*s|%-*s|%.*s", "abc", "abc", "abc", "abc", 6, "x", 6, "y", 1, "zz");
+	mismatches += fast_format_check_("%c%c%5c%-3c| 100%%", 'a', 'b', 'c', 'd');
+	mismatches += fast_format_check_("%p %20p", (void*)&mismatches, (void*)0);
+	mismatches += fast_format_check_("%f %g %e %.3f %10.2f %-10.1g| %lf %G %E", 3.14159, 0.0001234, 12345.678, 2.0005, -1.5, 1e10, 1.0 / 3, 1e-20, 5.5);
+	mismatches += fast_format_check_("%.2f %.0f %#.0f %010.3f %+.1f % .3f %-9.2f| %.17f", 0.125, 2.5, 3.0, -9.9999995, 0.05, -0.0, 1e16, 0.1);
+	mismatches += fast_format_check_("%g %g %g %.3g %#g %.10g %12g| %g %G", 0.0, 9.9999995, 100000.0, 0.0001235, 1.5, 2.0 / 3, -0.001, 1e-5, 123456789.0);
+	mismatches += fast_format_check_("%o %#o %#.0o %5.3o %-#6o| %hd %hu %hhd %hhx", 8u, 8u, 0u, 9u, 64u, 70000, 70000, 300, 257);
+	mismatches += fast_format_check_("%jd %td %I64d %I32u %Iu %hs %a %Lf", (intmax_t)-3, (ptrdiff_t)-4, 5LL, 7u, (size_t)9, "n", 1.5, (long double)2.25);
+	mismatches += wide_format_check_();
+	mismatches += dump_check_();
+	return mismatches;
+}
+
+/* known value, hardware against the table, bounded, on the stack */
+static int crc_check_(void)
+{
+	int mismatches = 0;
+	if (dbj_log_crc32c(0, "123456789", 9) != 0xE3069283u) {
+		dbj_log_error("crc32c is not as expected");
+		++mismatches;
+	}
+
+	unsigned char buf_[4096];
+	const size_t len_ = sizeof(buf_);
+	for (size_t j = 0; j < len_; ++j) buf_[j] = (unsigned char)((j * 2654435761u) >> 13);
+
+#ifdef DBJ_LOG_CRC_HW
+	/* unaligned, both heads and tails */
+	if (CRC.hardware && crc32c_sse42_(~0u, buf_ + 3, len_ - 7) != crc32c_table_(~0u, buf_ + 3, len_ - 7)) {
+		dbj_log_error("crc32c SSE4.2 and the table differ");
+		++mismatches;
+	}
+#endif // DBJ_LOG_CRC_HW
+
+	return mismatches;
+}
+
+/* public API too */
+void dbj_simple_log_test(const char* dummy_)
+{
+	dbj_log_scope_guard(DBJ_LOG_INFO, "internal test");
+
+	dbj_log_info(" ");
+	dbj_log_info("BEGIN Internal Test");
+	dbj_log_info(" ");
+	dbj_log_info("LOCAL.user_data       :  %4X", LOCAL.user_data);
+	dbj_log_info("LOCAL.lock            :  %4X", LOCAL.lock);
+	dbj_log_info("LOCAL.fp              :  %4X", LOCAL.fp);
+	dbj_log_info("LOCAL.level           :  %d", LOCAL.level);
+	dbj_log_info("LOCAL.no_console      :  %d", LOCAL.no_console);
+	dbj_log_info("LOCAL.file_line_show  :  %s", LOCAL.file_line_show ? "true" : "false");
+	dbj_log_info("LOCAL.full_time_stamp :  %s", LOCAL.full_time_stamp ? "true" : "false");
+	dbj_log_info("LOCAL.log_f_name set  :  %s", (LOCAL.log_f_name[0]) ? "true" : "false");
+#ifdef DBJ_LOG_RUNTIME_SETUP
+	dbj_log_info("setup                 :  runtime");
+#else
+	dbj_log_info("setup                 :  compile time, %d", (int)(DBJ_LOG_DEFAULT_SETUP));
+#endif
+	dbj_log_info(" ");
+
+	dbj_log_pool_stats pool_;
+	dbj_log_pool_get_stats(&pool_);
+	dbj_log_batch_begin(DBJ_LOG_INFO);
+	for (int k = 0; k < DBJ_LOG_POOL_CLASSES; ++k)
+		dbj_log_batch_line("pool class %5zu      :  capacity %zu, allocations %lld, in use %lld",
+			pool_.record_size[k], pool_.capacity[k], pool_.allocations[k], pool_.in_use[k]);
+	dbj_log_batch_line("pool heap allocations :  %lld", pool_.heap_allocations);
+	dbj_log_batch_end();
+	dbj_log_info(" ");
+	dbj_log_info("fast format mismatches:  %d", fast_format_conformance_());
+	dbj_log_hexdump(DBJ_LOG_INFO, level_names, sizeof(level_names), "level names, pointers");
+
+	if (DBJ_LOG_DEGRADE_LATENCY_US)
+		dbj_log_info("effective level       :  %s, write latency %lld us", level_names[dbj_simple_log_effective_level()],
+			DEGRADE.freq ? DEGRADE.ewma * 1000000 / DEGRADE.freq : 0);
+	dbj_log_info("crc32c                :  %s, mismatches %d%s",
+		CRC.hardware ? "SSE4.2" : "slicing by 8", crc_check_(), LOCAL.crc ? ", in use" : "");
+	if (CONSOLE.writer)
+		dbj_log_info("console lines dropped :  %lld", CONSOLE.dropped);
+#ifdef DBJ_LOG_NET_ENABLED
+	if (NET.sender)
+		dbj_log_info("network               :  %s:%s, frames sent %lld, spooled %lld, lost %lld, lines dropped %lld",
+			NET.host, NET.port, NET.frames_sent, NET.frames_spooled, NET.frames_lost, NET.dropped);
+#endif // DBJ_LOG_NET_ENABLED
+	if (LOCAL.tsc_stamp)
+		dbj_log_info("clock                 :  %s, %lld Hz", CLOCK.tsc ? "TSC" : "QPC", CLOCK.freq);
+	if (SAMPLE.on)
+		dbj_log_info("sampling              :  kept %lld, dropped %lld", SAMPLE.kept, SAMPLE.dropped);
+	if (PROFILE.on)
+		dbj_log_profile_report(5);
+	if (RING.shared)
+		dbj_log_info("shared ring           :  dropped %lld, truncated %lld", RING.shared->dropped, RING.shared->truncated);
+	dbj_log_info(" ");
+	dbj_log_trace("Log  TRACE");
+	dbj_log_debug("Log  DEBUG");
+	dbj_log_info("Log  INFO");
+	dbj_log_warn("Log  WARN");
+	dbj_log_error("Log  ERROR");
+	dbj_log_fatal("Log  FATAL");
+	dbj_log_info(" ");
+	dbj_log_info("END Internal Test");
+	dbj_log_info(" ");
+}
+
+// using clang this is called from destructor function
+// conditionaly defined on the bottom of this file
+// 
+// this might assert on debug builds
+// make sure it does not, on release builds
+//
+// called without the log lock, the lock is not recursive
+// reports log and the sinks lock for themselves
+// the log file is taken away under the lock, closed outside of it
+static int dbj_simplelog_finalize(void)
+{
+	// while there is still somewhere to log to
+	dbj_log_scope_dump();
+	dbj_log_profile_report(DBJ_LOG_PROFILE_TOP);
+
+	// shared ring is not a file
+	ring_close_();
+	compress_close_();
+	net_close_();
+	console_close_();
+
+	// make sure setup was called 
+	dbj_fhandle* fh = (dbj_fhandle*)LOCAL.user_data;
+
+	// log file was not made
+	// the session was in a console mode
+	if (fh == NULL) return EXIT_SUCCESS;
+
+	// lines logged from now on go to the console only, if at all
+	lock();
+	index_close_();
+	LOCAL.fp = NULL;
+	unlock();
+
+	if (log_file_preallocate_work_) {
+		WaitForThreadpoolWorkCallbacks(log_file_preallocate_work_, FALSE);
+		CloseThreadpoolWork(log_file_preallocate_work_);
+		log_file_preallocate_work_ = NULL;
+	}
+
+	FILE* fp_ = dbj_fhandle_log_file_ptr(NULL);
+	DBJ_ASSERT(fp_);
+	DBJ_FERROR(fp_);
+	if (fp_) fflush(fp_);
+	// make sure it is fclose, not close
+	if (fp_) {
+		fclose(fp_); fp_ = NULL;
+		return EXIT_SUCCESS;
+	}
+	return EXIT_FAILURE;
+}
+
+__attribute__((destructor))
+static void dbj_simple_log_destructor (void) {
+	int rez = dbj_simplelog_finalize();
+	_ASSERTE(EXIT_SUCCESS == rez);
+}
+
+#ifndef GetModuleFileName
+	__declspec(dllimport)
+		//_Success_(return != 0)
+		//_Ret_range_(1, nSize)
+	unsigned long
+		__stdcall
+		GetModuleFileNameA(
+			void* hModule,
+			char* lpFilename,
+			unsigned long nSize
+		);
+#endif // GetModuleFileName
+
+static bool startup_done = false;
+
+/* true if the caller is to do the startup */
+static bool startup_enter_(void)
+{
+	if (startup_state_ == 2) return false;
+
+	if (0 == InterlockedCompareExchange(&startup_state_, 1, 0)) {
+		startup_thread_ = GetCurrentThreadId();
+		return true;
+	}
+	// banner lines, from the startup itself
+	if (startup_thread_ == GetCurrentThreadId()) return false;
+
+	while (startup_state_ != 2) Sleep(0);
+	return false;
+}
+
+static void startup_leave_(bool done_)
+{
+	startup_done = done_;
+	startup_thread_ = 0;
+	InterlockedExchange(&startup_state_, done_ ? 2 : 0);
+}
+
+/*
+this will thus go into which ever log target you have set
+log file or console or both or none
+flushed once, not after each line
+*/
+static void startup_banner_(int setup)
+{
+	char full_tstamp_[32] = { 0 };
+	time_stamp_(&full_tstamp_, false, time(NULL));
+
+	LOCAL.flush_suspended = true;
+	dbj_log_info(" %s", "                                                              ");
+	dbj_log_info(" %s", "--------------------------------------------------------------");
+	dbj_log_info(" Start time: %s", full_tstamp_);
+	dbj_log_info(" %s", "                                                              ");
+	if (setup & DBJ_LOG_TO_FILE)
+		dbj_log_info(" Log file: %s", dbj_simplelog_file_path());
+	dbj_log_info(" %s", "                                                              ");
+	LOCAL.flush_suspended = false;
+
+	if (LOCAL.fp) fflush(LOCAL.fp);
+}
+
+// make sure you call this once upon app startup
+int dbj_simple_log_startup(
+	/*DBJ_LOG_SETUP*/ int dbj_simple_log_setup_, 
+	const char app_full_path[BUFSIZ]
+)
+{
+	// users must give value to this
+	// before this is called
+	// ideally before simplelog is ever used
+	// (void)/*extern int*/ dbj_simple_log_setup_;
+
+	// log file, or the spool of the network sink
+	if (dbj_simple_log_setup_ & (DBJ_LOG_TO_FILE | DBJ_LOG_NET)) {
+		if (!app_full_path) return EXIT_FAILURE;
+	}
+
+#ifndef DBJ_LOG_RUNTIME_SETUP
+	// log function is specialized for DBJ_LOG_DEFAULT_SETUP
+	// these can not be changed at runtime
+	{
+		const int fixed_ = DBJ_LOG_MT | DBJ_LOG_NO_CONSOLE | DBJ_LOG_FILELINE_SHOW
+			| DBJ_LOG_FULL_TIMESTAMP | DBJ_LOG_TSC_TIMESTAMP;
+		DBJ_ASSERT((dbj_simple_log_setup_ & fixed_) == ((DBJ_LOG_DEFAULT_SETUP) & fixed_));
+		if ((dbj_simple_log_setup_ & fixed_) != ((DBJ_LOG_DEFAULT_SETUP) & fixed_)) return EXIT_FAILURE;
+	}
+#endif // DBJ_LOG_RUNTIME_SETUP
+
+	if (!startup_enter_()) return EXIT_SUCCESS;
+
+	PREFIX.vt_mode = enable_vt_mode();
+
+	if (!dbj_log_setup(dbj_simple_log_setup_, app_full_path)) {
+		startup_leave_(false);
+		return EXIT_FAILURE;
+	}
+
+	startup_banner_(dbj_simple_log_setup_);
+
+	startup_leave_(true);
+	return EXIT_SUCCESS;
+}
+
+/*
+startup with the DBJ_LOG_DEFAULT_SETUP
+from the constructor or, DBJ_LOG_LAZY, from the first log line
+passing the level filter
+*/
+static void startup_once_(void)
+{
+	if (!startup_enter_()) return;
+
+	// colour console output 
+	// regardless of if console output is required
+	// or not
+	PREFIX.vt_mode = enable_vt_mode();
+
+	char app_full_path[1024] = { 0 };
+	// Q: is __argv available for windows desktop apps?
+	// A: no it is not
+	// win32 required here
+	int rez = GetModuleFileNameA(
+		NULL, app_full_path, 1024
+	);
+	DBJ_ASSERT(rez != 0);
+
+	if (DBJ_LOG_DEFAULT_SETUP & DBJ_LOG_TO_FILE) {
+		DBJ_ASSERT(app_full_path[0] != 0);
+	}
+
+	rez = dbj_log_setup(DBJ_LOG_DEFAULT_SETUP, app_full_path);
+	DBJ_ASSERT(rez != 0);
+
+	startup_banner_(DBJ_LOG_DEFAULT_SETUP);
+
+	startup_leave_(true);
+}
+
+__attribute__((constructor))
+static void dbj_simplelog_before(void)
+{
+	// DBJ_LOG_LAZY: nothing to do here, no file is made
+	// and no console is touched until the first log line
+	if (DBJ_LOG_DEFAULT_SETUP & DBJ_LOG_LAZY) return;
+
+	startup_once_();
+}
+
+#endif // _DBJ_SIMPLE_LOG_C_INCLUDED_
+
+#ifdef __cplusplus
+} // extern "C"
+#endif // __cplusplus
+#endif // DBJ_SIMPLELOG_IMPLEMENTATION
+
 #endif // _DBJ_SIMPLE_LOG_H_INCLUDED_
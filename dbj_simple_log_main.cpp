@@ -3,20 +3,11 @@ this is of course just a very quick check
 and shows how is dbj_simple_log to be used
 */
 
-#define DBJ_SIMPLELOG_IMPLEMENTATION
-#include "dbj_simple_log.h"
-
 // we override the default setup here
-#undef  DBJ_LOG_DEFAULT_SETUP
-#define DBJ_LOG_DEFAULT_SETUP ( DBJ_LOG_TO_FILE | DBJ_LOG_MT | DBJ_LOG_FILELINE_SHOW | DBJ_LOG_FULL_TIMESTAMP )
+#define DBJ_LOG_DEFAULT_SETUP ( DBJ_LOG_TO_FILE | DBJ_LOG_MT | DBJ_LOG_FILELINE_SHOW | DBJ_LOG_FULL_TIMESTAMP | DBJ_LOG_FILE_INDEX )
 
-#ifdef __cplusplus
-extern "C" {
-#endif // __cplusplus
-#include "dbj_simple_log.c"
-#ifdef __cplusplus
-} // extern "C" {
-#endif // __cplusplus
+#define DBJ_SIMPLELOG_IMPLEMENTATION
+#include "dbj_simple_log.h"
 
 /*
 filter whatever SEH is required to be filtered
@@ -0,0 +1,637 @@
+/* (c) 2019-2022 by dbj.org   -- LICENSE DBJ -- https://dbj.org/license_dbj/ */
+/*
+the logging path, measured
+
+usage: dbj_log_bench [options]
+
+	-lines <n>      lines per setup run, default 100000
+	-flush          flush after each line, as the logger does by default
+	                without it the disk is left out, only the logging path is measured
+	-console        console setups too, they do write to this console
+
+each setup is run in its own process, this exe started again with -run
+the log files are this exe path + .log, as for any app
+
+	pool            record pool against the heap, per record
+	format          fast formatter against snprintf, per specifier
+	wide            %ls UTF-16 to UTF-8, against WideCharToMultiByte and wcstombs, MB/s
+	setups          one log line per setup, each feature on and off:
+	                wall ns, cycles of the logging thread and the process CPU ns,
+	                heap calls made while logging, difference to the plain file setup
+	batch           plain file setup, lines in batches of 32 against one by one,
+	                without and with the flush, the flushed runs have 1/10 of the lines
+	crc             crc32c of one record alone, then the plain file setup against
+	                + CRC, median of 5 runs, without and with the flush
+	startup         eager against DBJ_LOG_LAZY, for the app that logs nothing:
+	                process start to exit, median, and the startup itself
+	specialized     plain file setup, the log function specialized at compile time
+	                against the DBJ_LOG_RUNTIME_SETUP one, this exe
+
+specialized one is the second build of this file, next to this exe:
+
+	clang-cl /O2 /DDBJ_LOG_BENCH_FIXED tools\dbj_log_bench.c /Fe:dbj_log_bench_fixed.exe
+
+it does the -run of the plain file setup only
+*/
+
+// nothing before main, runs are started by dbj_simple_log_startup
+#ifdef DBJ_LOG_BENCH_FIXED
+#define DBJ_LOG_DEFAULT_SETUP ( DBJ_LOG_LAZY | DBJ_LOG_TO_FILE | DBJ_LOG_MT | DBJ_LOG_NO_CONSOLE )
+#else
+#define DBJ_LOG_RUNTIME_SETUP
+#define DBJ_LOG_DEFAULT_SETUP ( DBJ_LOG_LAZY | DBJ_LOG_TO_FILE | DBJ_LOG_MT )
+#endif
+
+// the + NET setup
+#define DBJ_LOG_NET_ENABLED
+#define DBJ_SIMPLELOG_IMPLEMENTATION
+#include "../dbj_simple_log.h"
+
+#include <locale.h>
+
+/* what every setup has, unless it says otherwise */
+#define bench_file_ ( DBJ_LOG_TO_FILE | DBJ_LOG_MT | DBJ_LOG_NO_CONSOLE )
+
+static const struct {
+	const char* name;
+	int setup;
+	/* writes to this console */
+	bool console;
+} setups_[] = {
+	{ "file", bench_file_, false },
+	{ "+ FILELINE_SHOW", bench_file_ | DBJ_LOG_FILELINE_SHOW, false },
+	{ "+ FULL_TIMESTAMP", bench_file_ | DBJ_LOG_FULL_TIMESTAMP, false },
+	{ "+ TSC_TIMESTAMP", bench_file_ | DBJ_LOG_TSC_TIMESTAMP, false },
+	{ "+ FILE_INDEX", bench_file_ | DBJ_LOG_FILE_INDEX, false },
+	{ "+ CRC", bench_file_ | DBJ_LOG_CRC, false },
+	{ "+ PROFILE", bench_file_ | DBJ_LOG_PROFILE, false },
+	{ "+ COMPRESS", bench_file_ | DBJ_LOG_COMPRESS, false },
+	{ "+ SHARED_RING", bench_file_ | DBJ_LOG_SHARED_RING, false },
+	{ "+ NET, no collector", bench_file_ | DBJ_LOG_NET, false },
+	{ "- MT", bench_file_ & ~DBJ_LOG_MT, false },
+	{ "console", DBJ_LOG_MT, true },
+	{ "console, CONSOLE_ASYNC", DBJ_LOG_MT | DBJ_LOG_CONSOLE_ASYNC, true },
+};
+
+#define setups_count_ (int)(sizeof(setups_) / sizeof(setups_[0]))
+
+static char self_[1024];
+/* the specialized build, next to this exe */
+static char fixed_[1024];
+
+static long long now_ns_(void)
+{
+	static LARGE_INTEGER freq_;
+	if (!freq_.QuadPart) QueryPerformanceFrequency(&freq_);
+	LARGE_INTEGER now_;
+	QueryPerformanceCounter(&now_);
+	return (long long)((double)now_.QuadPart * 1e9 / (double)freq_.QuadPart);
+}
+
+static unsigned long long thread_cycles_(void)
+{
+	ULONG64 cycles_ = 0;
+	QueryThreadCycleTime(GetCurrentThread(), &cycles_);
+	return cycles_;
+}
+
+/* user and kernel, all the threads, in ns */
+static long long process_cpu_ns_(void)
+{
+	FILETIME made_, ended_, kernel_, user_;
+	GetProcessTimes(GetCurrentProcess(), &made_, &ended_, &kernel_, &user_);
+	const unsigned long long k_ = ((unsigned long long)kernel_.dwHighDateTime << 32) | kernel_.dwLowDateTime;
+	const unsigned long long u_ = ((unsigned long long)user_.dwHighDateTime << 32) | user_.dwLowDateTime;
+	return (long long)(k_ + u_) * 100;
+}
+
+/*
+the exe with the args given, its stdout into the out
+ns is the wall time from the start to the exit
+*/
+static bool child_run_(const char* exe, const char* args, char* out, DWORD out_size, long long* ns)
+{
+	char cmd_[2048] = { 0 };
+	snprintf(cmd_, sizeof(cmd_), "\"%s\" %s", exe, args);
+
+	SECURITY_ATTRIBUTES inherit_ = { sizeof(inherit_), NULL, TRUE };
+	HANDLE read_ = NULL, write_ = NULL;
+	if (!CreatePipe(&read_, &write_, &inherit_, 0)) return false;
+	SetHandleInformation(read_, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFOA start_ = { sizeof(start_) };
+	start_.dwFlags = STARTF_USESTDHANDLES;
+	start_.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	start_.hStdOutput = write_;
+	start_.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+	PROCESS_INFORMATION child_ = { 0 };
+	const long long begin_ = now_ns_();
+	const BOOL made_ = CreateProcessA(NULL, cmd_, NULL, NULL, TRUE, 0, NULL, NULL, &start_, &child_);
+	CloseHandle(write_);
+	if (!made_) {
+		CloseHandle(read_);
+		return false;
+	}
+
+	DWORD all_ = 0, got_ = 0;
+	while (all_ + 1 < out_size && ReadFile(read_, out + all_, out_size - 1 - all_, &got_, NULL) && got_)
+		all_ += got_;
+	out[all_] = '\0';
+	CloseHandle(read_);
+
+	WaitForSingleObject(child_.hProcess, INFINITE);
+	if (ns) *ns = now_ns_() - begin_;
+
+	DWORD code_ = EXIT_FAILURE;
+	GetExitCodeProcess(child_.hProcess, &code_);
+	CloseHandle(child_.hThread);
+	CloseHandle(child_.hProcess);
+	return code_ == EXIT_SUCCESS;
+}
+
+/* the same line in every setup run */
+static void bench_line_(int j)
+{
+	dbj_log_info("order %d accepted, user %s, amount %.2f", j, "somebody", j * 0.25);
+}
+
+/* the same line, in the batch */
+static void bench_batch_line_(int j)
+{
+	dbj_log_batch_line("order %d accepted, user %s, amount %.2f", j, "somebody", j * 0.25);
+}
+
+/* lines from..to, one by one or in batches of that many */
+static void bench_lines_(int from, int to, int batch)
+{
+	if (batch < 2) {
+		for (int j = from; j < to; ++j) bench_line_(j);
+		return;
+	}
+	for (int j = from; j < to; ) {
+		dbj_log_batch_begin(DBJ_LOG_INFO);
+		for (int b = 0; b < batch && j < to; ++b, ++j) bench_batch_line_(j);
+		dbj_log_batch_end();
+	}
+}
+
+/*
+child: one setup, lines logged, measured
+stdout: wall ns, thread cycles and process CPU ns per line, heap calls
+*/
+static int run_(int setup, int lines, bool flush, int batch)
+{
+	if (EXIT_SUCCESS != dbj_simple_log_startup(setup, self_)) return EXIT_FAILURE;
+
+	LOCAL.flush_suspended = !flush;
+
+	// pool, file, threads, all made before measuring
+	bench_lines_(0, 1000, batch);
+
+	dbj_log_pool_stats before_, after_;
+	dbj_log_pool_get_stats(&before_);
+
+	const long long cpu_ = process_cpu_ns_();
+	const unsigned long long cycles_ = thread_cycles_();
+	const long long begin_ = now_ns_();
+
+	bench_lines_(0, lines, batch);
+
+	const long long wall_ = now_ns_() - begin_;
+	const unsigned long long spent_ = thread_cycles_() - cycles_;
+	const long long cpu_spent_ = process_cpu_ns_() - cpu_;
+
+	dbj_log_pool_get_stats(&after_);
+
+	printf("%.1f %.1f %.1f %lld\n", (double)wall_ / lines, (double)spent_ / lines,
+		(double)cpu_spent_ / lines, after_.heap_allocations - before_.heap_allocations);
+	return EXIT_SUCCESS;
+}
+
+/*
+child: startup only, one line below the level
+eager is what the constructor does before main, lazy does nothing
+stdout: ns the startup took
+*/
+static int startup_run_(const char* mode)
+{
+	long long took_ = 0;
+
+	if (0 == strcmp(mode, "eager")) {
+		const long long begin_ = now_ns_();
+		if (EXIT_SUCCESS != dbj_simple_log_startup(bench_file_, self_)) return EXIT_FAILURE;
+		took_ = now_ns_() - begin_;
+	}
+	else if (0 != strcmp(mode, "lazy") && 0 != strcmp(mode, "none")) {
+		return EXIT_FAILURE;
+	}
+
+	if (0 != strcmp(mode, "none")) {
+		dbj_simple_log_set_level(DBJ_LOG_WARN);
+		dbj_log_info("below the level, not logged");
+	}
+
+	printf("%lld\n", took_);
+	return EXIT_SUCCESS;
+}
+
+static int compare_ll_(const void* a_, const void* b_)
+{
+	const long long a = *(const long long*)a_, b = *(const long long*)b_;
+	return (a > b) - (a < b);
+}
+
+static void startup_bench_(void)
+{
+	enum { runs_ = 21 };
+	static const char* modes_[] = { "none", "lazy", "eager" };
+
+	printf("\nstartup, median of %d processes, nothing logged\n", runs_);
+	printf("%-28s %10s %12s\n", "", "process us", "startup us");
+
+	for (int m = 0; m < 3; ++m)
+	{
+		long long walls_[runs_], tooks_[runs_];
+		char args_[64] = { 0 }, out_[64] = { 0 };
+		snprintf(args_, sizeof(args_), "-startup %s", modes_[m]);
+
+		int done_ = 0;
+		for (int r = 0; r < runs_; ++r)
+			if (child_run_(self_, args_, out_, sizeof(out_), &walls_[done_]) && 1 == sscanf_s(out_, "%lld", &tooks_[done_]))
+				++done_;
+
+		if (!done_) {
+			printf("%-28s failed\n", modes_[m]);
+			continue;
+		}
+		qsort(walls_, done_, sizeof(walls_[0]), compare_ll_);
+		qsort(tooks_, done_, sizeof(tooks_[0]), compare_ll_);
+		printf("%-28s %10.1f %12.1f\n", m == 0 ? "none, the process alone" : modes_[m],
+			walls_[done_ / 2] / 1000.0, tooks_[done_ / 2] / 1000.0);
+	}
+}
+
+static void pool_bench_(void)
+{
+	enum { rounds_ = 1000000 };
+	const size_t size_ = 200;
+
+	printf("\npool, %d records of %zu bytes, taken and given back\n", rounds_, size_);
+
+	// pool is made on the first use
+	record_free_(record_alloc_(size_));
+
+	long long begin_ = now_ns_();
+	for (int j = 0; j < rounds_; ++j)
+		record_free_(record_alloc_(size_));
+	const double pool_ = (double)(now_ns_() - begin_) / rounds_;
+
+	begin_ = now_ns_();
+	for (int j = 0; j < rounds_; ++j) {
+		void* volatile rec_ = _aligned_malloc(sizeof(dbj_log_record_) + size_, MEMORY_ALLOCATION_ALIGNMENT);
+		_aligned_free(rec_);
+	}
+	const double heap_ = (double)(now_ns_() - begin_) / rounds_;
+
+	printf("%-28s %10.1f ns\n", "pool", pool_);
+	printf("%-28s %10.1f ns\n", "_aligned_malloc, _aligned_free", heap_);
+}
+
+/* the same format and args, fast formatter and snprintf, ns per call */
+#define format_case_(FMT_, ...) do { \
+	long long begin_ = now_ns_(); \
+	for (int j = 0; j < rounds_; ++j) fast_format_va_(buf_, sizeof(buf_), FMT_, __VA_ARGS__); \
+	const double fast_ = (double)(now_ns_() - begin_) / rounds_; \
+	begin_ = now_ns_(); \
+	for (int j = 0; j < rounds_; ++j) snprintf(buf_, sizeof(buf_), FMT_, __VA_ARGS__); \
+	const double crt_ = (double)(now_ns_() - begin_) / rounds_; \
+	printf("%-28s %10.1f %10.1f %9.1fx\n", FMT_, fast_, crt_, crt_ / fast_); \
+} while (0)
+
+static void format_bench_(void)
+{
+	enum { rounds_ = 1000000 };
+	static char buf_[512];
+
+	printf("\nformat, %d calls each\n", rounds_);
+	printf("%-28s %10s %10s %10s\n", "", "fast ns", "snprintf", "");
+
+	format_case_("%d", j);
+	format_case_("%lld", (long long)j * 1000003);
+	format_case_("%08x", (unsigned)j);
+	format_case_("%s", "somebody");
+	format_case_("%-12s|", "somebody");
+	format_case_("%p", (void*)buf_);
+	format_case_("%f", j * 0.37);
+	format_case_("%.2f", j * 0.37);
+	format_case_("%10.3f", j * -0.37);
+	format_case_("%g", j * 0.37);
+	format_case_("%.3g", j * 0.37);
+	// not done by the fast formatter, snprintf both ways
+	format_case_("%e", j * 0.37);
+	format_case_("order %d accepted, user %s, amount %.2f", j, "somebody", j * 0.25);
+}
+
+/* MB/s of the UTF-16 bytes converted */
+#define wide_mb_s_(NS_) ((double)sizeof(text_) * rounds_ * 1000 / (double)(NS_) )
+
+/*
+the same text three ways, into the buffer big enough
+wcstombs_s is given the UTF-8 locale, to do the same job
+*/
+static void wide_bench_(void)
+{
+	enum { rounds_ = 200000 };
+	static wchar_t text_[256];
+	static char out_[1024];
+	static const struct { const char* name; unsigned every; } kinds_[] = {
+		{ "ASCII", 0 }, { "1 in 16 not ASCII", 16 }, { "1 in 2 not ASCII", 2 }
+	};
+
+	printf("\nwide, %zu wchar_t, %d conversions, MB/s of UTF-16\n", DBJ_COUNT_OF(text_) - 1, rounds_);
+	printf("%-28s %10s %10s %10s\n", "", "logger", "WCtoMB", "wcstombs");
+
+	const char* old_locale_ = setlocale(LC_ALL, ".UTF8");
+
+	for (size_t k = 0; k < DBJ_COUNT_OF(kinds_); ++k)
+	{
+		for (size_t j = 0; j < DBJ_COUNT_OF(text_) - 1; ++j)
+			text_[j] = (kinds_[k].every && j % kinds_[k].every == 0) ? (wchar_t)(j & 1 ? 0x00E9 : 0x4E2D) : (wchar_t)('a' + j % 26);
+		text_[DBJ_COUNT_OF(text_) - 1] = 0;
+		const int len_ = (int)DBJ_COUNT_OF(text_) - 1;
+
+		size_t consumed_ = 0;
+		long long begin_ = now_ns_();
+		for (int j = 0; j < rounds_; ++j) utf16_to_utf8_(text_, (size_t)len_, out_, sizeof(out_), &consumed_);
+		const long long logger_ = now_ns_() - begin_;
+
+		begin_ = now_ns_();
+		for (int j = 0; j < rounds_; ++j) WideCharToMultiByte(CP_UTF8, 0, text_, len_, out_, (int)sizeof(out_), NULL, NULL);
+		const long long win_ = now_ns_() - begin_;
+
+		size_t made_ = 0;
+		begin_ = now_ns_();
+		for (int j = 0; j < rounds_; ++j) wcstombs_s(&made_, out_, sizeof(out_), text_, _TRUNCATE);
+		const long long crt_ = now_ns_() - begin_;
+
+		if (old_locale_)
+			printf("%-28s %10.0f %10.0f %10.0f\n", kinds_[k].name, wide_mb_s_(logger_), wide_mb_s_(win_), wide_mb_s_(crt_));
+		else
+			printf("%-28s %10.0f %10.0f %10s\n", kinds_[k].name, wide_mb_s_(logger_), wide_mb_s_(win_), "no UTF-8");
+	}
+	setlocale(LC_ALL, "C");
+}
+
+#undef wide_mb_s_
+
+static void setups_bench_(int lines, bool flush, bool console)
+{
+	printf("\nlogging path, %d lines per setup, %s\n", lines, flush ? "flushed after each line" : "no flush");
+	printf("%-28s %10s %12s %12s %6s %10s\n", "", "ns/line", "cycles/line", "cpu ns/line", "heap", "vs file");
+
+	double file_cycles_ = 0;
+	for (int j = 0; j < setups_count_; ++j)
+	{
+		if (setups_[j].console && !console) continue;
+
+		char args_[128] = { 0 }, out_[256] = { 0 };
+		snprintf(args_, sizeof(args_), "-run %d -lines %d%s", setups_[j].setup, lines, flush ? " -flush" : "");
+
+		double wall_ = 0, cycles_ = 0, cpu_ = 0;
+		long long heap_ = 0;
+		if (!child_run_(self_, args_, out_, sizeof(out_), NULL)
+			|| 4 != sscanf_s(out_, "%lf %lf %lf %lld", &wall_, &cycles_, &cpu_, &heap_)) {
+			printf("%-28s failed\n", setups_[j].name);
+			continue;
+		}
+
+		if (j == 0) {
+			file_cycles_ = cycles_;
+			printf("%-28s %10.1f %12.1f %12.1f %6lld %10s\n", setups_[j].name, wall_, cycles_, cpu_, heap_, "--");
+		}
+		else {
+			const double vs_ = file_cycles_ > 0 ? (cycles_ - file_cycles_) * 100 / file_cycles_ : 0;
+			printf("%-28s %10.1f %12.1f %12.1f %6lld %+9.1f%%\n", setups_[j].name, wall_, cycles_, cpu_, heap_, vs_);
+		}
+	}
+}
+
+/* median wall ns and cycles per line of the runs, each in its own process, false if all failed */
+static bool median_run_(const char* exe, const char* args, int runs, double* wall, double* cycles)
+{
+	long long walls_[16], cycles_[16];
+	int done_ = 0;
+	if (runs > 16) runs = 16;
+	for (int r = 0; r < runs; ++r) {
+		char out_[256] = { 0 };
+		double wall_ = 0, cycles_per_ = 0, cpu_ = 0;
+		long long heap_ = 0;
+		if (child_run_(exe, args, out_, sizeof(out_), NULL)
+			&& 4 == sscanf_s(out_, "%lf %lf %lf %lld", &wall_, &cycles_per_, &cpu_, &heap_)) {
+			// tenths, to sort as integers
+			walls_[done_] = (long long)(wall_ * 10);
+			cycles_[done_] = (long long)(cycles_per_ * 10);
+			++done_;
+		}
+	}
+	if (!done_) return false;
+	qsort(walls_, done_, sizeof(walls_[0]), compare_ll_);
+	qsort(cycles_, done_, sizeof(cycles_[0]), compare_ll_);
+	*wall = walls_[done_ / 2] / 10.0;
+	*cycles = cycles_[done_ / 2] / 10.0;
+	return true;
+}
+
+/*
+the same plain file setup, the same lines
+log function with the setup fixed at compile time, and the runtime one
+median of the runs, each in its own process
+*/
+static void specialized_bench_(int lines, bool flush)
+{
+	enum { runs_ = 5 };
+	static const char* names_[] = { "DBJ_LOG_RUNTIME_SETUP", "specialized" };
+	const char* exes_[] = { self_, fixed_ };
+
+	printf("\nspecialized, file setup, %d lines, median of %d runs, %s\n", lines, runs_, flush ? "flushed after each line" : "no flush");
+
+	if (GetFileAttributesA(fixed_) == INVALID_FILE_ATTRIBUTES) {
+		printf("%s not found, build it with /DDBJ_LOG_BENCH_FIXED\n", fixed_);
+		return;
+	}
+	printf("%-28s %10s %12s %10s\n", "", "ns/line", "cycles/line", "vs runtime");
+
+	char args_[128] = { 0 };
+	snprintf(args_, sizeof(args_), "-run %d -lines %d%s", bench_file_, lines, flush ? " -flush" : "");
+
+	double runtime_cycles_ = 0;
+	for (int e = 0; e < 2; ++e)
+	{
+		double wall_ = 0, cycles_ = 0;
+		if (!median_run_(exes_[e], args_, runs_, &wall_, &cycles_)) {
+			printf("%-28s failed\n", names_[e]);
+			continue;
+		}
+
+		if (e == 0) {
+			runtime_cycles_ = cycles_;
+			printf("%-28s %10.1f %12.1f %10s\n", names_[e], wall_, cycles_, "--");
+		}
+		else {
+			const double vs_ = runtime_cycles_ > 0 ? (cycles_ - runtime_cycles_) * 100 / runtime_cycles_ : 0;
+			printf("%-28s %10.1f %12.1f %+9.1f%%\n", names_[e], wall_, cycles_, vs_);
+		}
+	}
+}
+
+/*
+what DBJ_LOG_CRC costs
+crc32c alone, over the record as the file setup writes it for the bench line
+then the plain file setup against + CRC, median of the runs, each in its own process
+without and with the flush, the flushed runs have 1/10 of the lines
+*/
+static void crc_bench_(int lines)
+{
+	enum { runs_ = 5, rounds_ = 1000000 };
+
+	char text_[256] = { 0 };
+	const int len_ = snprintf(text_, sizeof(text_), "%s INFO  order %d accepted, user %s, amount %.2f\n",
+		"12:34:56", 4242, "somebody", 4242 * 0.25);
+	volatile unsigned sink_ = 0;
+
+	const long long begin_ = now_ns_();
+	for (int j = 0; j < rounds_; ++j)
+		sink_ += crc_header_(text_, (size_t)len_).crc;
+	const double crc_ns_ = (double)(now_ns_() - begin_) / rounds_;
+	(void)sink_;
+
+	printf("\nCRC, %s, %d lines, median of %d runs\n", CRC.hardware ? "SSE4.2" : "slicing by 8", lines, runs_);
+	printf("%-28s %10.1f ns\n", "crc32c, one record", crc_ns_);
+	printf("%-28s %10s %12s %10s\n", "", "ns/line", "cycles/line", "vs file");
+
+	for (int flush_ = 0; flush_ < 2; ++flush_)
+	{
+		const int lines_ = flush_ ? (lines + 9) / 10 : lines;
+		double file_wall_ = 0;
+
+		for (int c = 0; c < 2; ++c)
+		{
+			char args_[128] = { 0 }, name_[64] = { 0 };
+			snprintf(args_, sizeof(args_), "-run %d -lines %d%s", c ? bench_file_ | DBJ_LOG_CRC : bench_file_, lines_, flush_ ? " -flush" : "");
+			snprintf(name_, sizeof(name_), "%s, %d lines%s", c ? "+ CRC" : "file", lines_, flush_ ? ", flush" : "");
+
+			double wall_ = 0, cycles_ = 0;
+			if (!median_run_(self_, args_, runs_, &wall_, &cycles_)) {
+				printf("%-28s failed\n", name_);
+				continue;
+			}
+			if (c == 0) {
+				file_wall_ = wall_;
+				printf("%-28s %10.1f %12.1f %10s\n", name_, wall_, cycles_, "--");
+			}
+			else {
+				const double vs_ = file_wall_ > 0 ? (wall_ - file_wall_) * 100 / file_wall_ : 0;
+				printf("%-28s %10.1f %12.1f %+9.1f%%\n", name_, wall_, cycles_, vs_);
+			}
+		}
+	}
+}
+
+/*
+the same plain file setup, the same lines
+one by one, and in batches of 32: one lock, one time stamp, one write and one flush each
+*/
+static void batch_bench_(int lines)
+{
+	enum { batch_ = 32 };
+
+	printf("\nbatch of %d lines, file setup\n", batch_);
+	printf("%-28s %10s %12s %10s\n", "", "ns/line", "cycles/line", "faster");
+
+	for (int flush_ = 0; flush_ < 2; ++flush_)
+	{
+		const int lines_ = flush_ ? (lines + 9) / 10 : lines;
+		double one_wall_ = 0;
+
+		for (int b = 0; b < 2; ++b)
+		{
+			char args_[128] = { 0 }, out_[256] = { 0 }, name_[64] = { 0 };
+			snprintf(args_, sizeof(args_), "-run %d -lines %d%s -batch %d", bench_file_, lines_, flush_ ? " -flush" : "", b ? batch_ : 1);
+			snprintf(name_, sizeof(name_), "%s, %d lines%s", b ? "batch" : "one by one", lines_, flush_ ? ", flush" : "");
+
+			double wall_ = 0, cycles_ = 0, cpu_ = 0;
+			long long heap_ = 0;
+			if (!child_run_(self_, args_, out_, sizeof(out_), NULL)
+				|| 4 != sscanf_s(out_, "%lf %lf %lf %lld", &wall_, &cycles_, &cpu_, &heap_)) {
+				printf("%-28s failed\n", name_);
+				continue;
+			}
+			if (b == 0) {
+				one_wall_ = wall_;
+				printf("%-28s %10.1f %12.1f %10s\n", name_, wall_, cycles_, "--");
+			}
+			else {
+				printf("%-28s %10.1f %12.1f %9.1fx\n", name_, wall_, cycles_, wall_ > 0 ? one_wall_ / wall_ : 0);
+			}
+		}
+	}
+}
+
+static int usage_(void)
+{
+	fprintf(stderr, "usage: dbj_log_bench [-lines <n>] [-flush] [-console]\n");
+	return EXIT_FAILURE;
+}
+
+int main(const int argc, char* argv[])
+{
+	GetModuleFileNameA(NULL, self_, sizeof(self_));
+
+	int lines_ = 100000, run_setup_ = -1, batch_ = 1;
+	const char* startup_mode_ = NULL;
+	bool flush_ = false, console_ = false;
+
+	for (int j = 1; j < argc; ++j) {
+		if (0 == strcmp(argv[j], "-lines") && j + 1 < argc)
+			lines_ = atoi(argv[++j]);
+		else if (0 == strcmp(argv[j], "-run") && j + 1 < argc)
+			run_setup_ = atoi(argv[++j]);
+		else if (0 == strcmp(argv[j], "-batch") && j + 1 < argc)
+			batch_ = atoi(argv[++j]);
+		else if (0 == strcmp(argv[j], "-startup") && j + 1 < argc)
+			startup_mode_ = argv[++j];
+		else if (0 == strcmp(argv[j], "-flush"))
+			flush_ = true;
+		else if (0 == strcmp(argv[j], "-console"))
+			console_ = true;
+		else
+			return usage_();
+	}
+	if (lines_ < 1) return usage_();
+
+	if (startup_mode_) return startup_run_(startup_mode_);
+	if (run_setup_ >= 0) return run_(run_setup_, lines_, flush_, batch_);
+
+#ifdef DBJ_LOG_BENCH_FIXED
+	// started by dbj_log_bench only
+	return usage_();
+#else
+	// dbj_log_bench.exe -> dbj_log_bench_fixed.exe
+	strcpy_s(fixed_, sizeof(fixed_), self_);
+	char* dot_ = strrchr(fixed_, '.');
+	if (dot_) *dot_ = '\0';
+	strcat_s(fixed_, sizeof(fixed_), "_fixed.exe");
+
+	printf("dbj_log_bench, %s\n", self_);
+	pool_bench_();
+	format_bench_();
+	wide_bench_();
+	setups_bench_(lines_, flush_, console_);
+	specialized_bench_(lines_, flush_);
+	batch_bench_(lines_);
+	crc_bench_(lines_);
+	startup_bench_();
+	return EXIT_SUCCESS;
+#endif
+}
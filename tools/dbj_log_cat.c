@@ -0,0 +1,200 @@
+/* (c) 2019-2022 by dbj.org   -- LICENSE DBJ -- https://dbj.org/license_dbj/ */
+/*
+print the log file written with DBJ_LOG_COMPRESS in the setup
+
+usage: dbj_log_cat <log file>.lz4 [options]
+
+	-list           frames, not the text: number, file offset, text offset, sizes
+	-from <n>       text from the frame n on, 0 is the first
+	-count <n>      this many frames only
+
+seek table at the end of the file is used to jump straight to the frame
+without it, after the crash, frames are walked from the start
+*/
+
+#include "../dbj_simple_log.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <share.h>
+
+/* LZ4 worst case, see the compressor */
+#define frame_max_ (DBJ_LOG_COMPRESS_BLOCK + DBJ_LOG_COMPRESS_BLOCK / 255 + 16)
+
+static unsigned char packed_[frame_max_];
+static unsigned char text_[DBJ_LOG_COMPRESS_BLOCK];
+
+/*
+LZ4 block format
+returns the text length, or -1 on the bad input
+*/
+static long lz4_decompress_(const unsigned char* src, size_t n, unsigned char* dst, size_t cap)
+{
+	const unsigned char* ip = src;
+	const unsigned char* const end = src + n;
+	unsigned char* op = dst;
+	unsigned char* const op_end = dst + cap;
+
+	while (ip < end)
+	{
+		const unsigned token = *ip++;
+
+		size_t len = token >> 4;
+		if (len == 15) {
+			unsigned char more;
+			do {
+				if (ip >= end) return -1;
+				more = *ip++;
+				len += more;
+			} while (more == 255);
+		}
+		if ((size_t)(end - ip) < len || (size_t)(op_end - op) < len) return -1;
+		memcpy(op, ip, len);
+		ip += len;
+		op += len;
+
+		/* the last sequence has no match */
+		if (ip == end) break;
+
+		if (end - ip < 2) return -1;
+		const size_t offset = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > (size_t)(op - dst)) return -1;
+
+		len = token & 15;
+		if (len == 15) {
+			unsigned char more;
+			do {
+				if (ip >= end) return -1;
+				more = *ip++;
+				len += more;
+			} while (more == 255);
+		}
+		len += 4;
+		if ((size_t)(op_end - op) < len) return -1;
+
+		/* overlapping copy, byte by byte */
+		const unsigned char* ref = op - offset;
+		while (len--) *op++ = *ref++;
+	}
+	return (long)(op - dst);
+}
+
+/* NULL if no seek table, caller frees */
+static dbj_log_seek_entry* seek_table_load_(FILE* fp, size_t* count)
+{
+	*count = 0;
+	dbj_log_seek_trailer trailer_ = { 0 };
+
+	if (_fseeki64(fp, -(long long)sizeof(trailer_), SEEK_END) != 0) return NULL;
+	if (1 != fread(&trailer_, sizeof(trailer_), 1, fp) || trailer_.magic != DBJ_LOG_SEEK_MAGIC) return NULL;
+	if (_fseeki64(fp, (long long)trailer_.table_offset, SEEK_SET) != 0) return NULL;
+
+	dbj_log_seek_entry* entries = (dbj_log_seek_entry*)calloc(trailer_.count ? trailer_.count : 1, sizeof(dbj_log_seek_entry));
+	if (entries) *count = fread(entries, sizeof(dbj_log_seek_entry), trailer_.count, fp);
+	return entries;
+}
+
+/* false at the end, or at the first bad frame */
+static bool frame_read_(FILE* fp, dbj_log_frame_header* header, long* text_len)
+{
+	if (1 != fread(header, sizeof(*header), 1, fp)) return false;
+	if (header->magic != DBJ_LOG_FRAME_MAGIC
+		|| header->stored_size > frame_max_ || header->raw_size > DBJ_LOG_COMPRESS_BLOCK) return false;
+	if (header->stored_size != fread(packed_, 1, header->stored_size, fp)) return false;
+
+	if (header->flags & DBJ_LOG_FRAME_RAW) {
+		memcpy(text_, packed_, header->stored_size);
+		*text_len = (long)header->stored_size;
+	}
+	else {
+		*text_len = lz4_decompress_(packed_, header->stored_size, text_, sizeof(text_));
+	}
+	return *text_len == (long)header->raw_size;
+}
+
+static int usage_(const char* self)
+{
+	fprintf(stderr, "usage: %s <log file>.lz4 [-list] [-from <frame>] [-count <frames>]\n", self);
+	return EXIT_FAILURE;
+}
+
+int main(const int argc, char* argv[])
+{
+	if (argc < 2) return usage_(argv[0]);
+
+	bool list_ = false;
+	unsigned long long from_ = 0, count_ = (unsigned long long)-1;
+
+	for (int j = 2; j < argc; ++j) {
+		const bool has_value = j + 1 < argc;
+		if (0 == strcmp(argv[j], "-list")) {
+			list_ = true;
+		}
+		else if (0 == strcmp(argv[j], "-from") && has_value) {
+			from_ = strtoull(argv[++j], NULL, 10);
+		}
+		else if (0 == strcmp(argv[j], "-count") && has_value) {
+			count_ = strtoull(argv[++j], NULL, 10);
+		}
+		else {
+			return usage_(argv[0]);
+		}
+	}
+
+	FILE* fp = _fsopen(argv[1], "rb", _SH_DENYNO);
+	if (!fp) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	size_t seek_count_ = 0;
+	dbj_log_seek_entry* seek_ = seek_table_load_(fp, &seek_count_);
+	unsigned long long frame_ = 0, text_offset_ = 0;
+
+	if (seek_ && from_ < seek_count_) {
+		frame_ = from_;
+		text_offset_ = seek_[from_].raw_offset;
+		_fseeki64(fp, (long long)seek_[from_].offset, SEEK_SET);
+	}
+	else if (seek_ && from_ >= seek_count_) {
+		frame_ = from_;
+		count_ = 0;
+	}
+	else {
+		_fseeki64(fp, 0, SEEK_SET);
+	}
+	free(seek_);
+
+	dbj_log_frame_header header_;
+	long text_len_ = 0;
+	int rez_ = EXIT_SUCCESS;
+
+	while (count_ > 0)
+	{
+		const long long offset_ = _ftelli64(fp);
+		if (!frame_read_(fp, &header_, &text_len_)) {
+			/* not the end, seek table or the half written frame */
+			if (header_.magic == DBJ_LOG_FRAME_MAGIC && !feof(fp)) {
+				fprintf(stderr, "%s: bad frame %llu at %lld\n", argv[1], frame_, offset_);
+				rez_ = EXIT_FAILURE;
+			}
+			break;
+		}
+
+		if (frame_ >= from_) {
+			if (list_)
+				printf("%8llu %12lld %14llu %8u -> %8u%s\n", frame_, offset_, text_offset_,
+					header_.stored_size, header_.raw_size, (header_.flags & DBJ_LOG_FRAME_RAW) ? " raw" : "");
+			else
+				fwrite(text_, 1, (size_t)text_len_, stdout);
+			count_ -= 1;
+		}
+		frame_ += 1;
+		text_offset_ += header_.raw_size;
+		header_.magic = 0;
+	}
+
+	fclose(fp);
+	return rez_;
+}
@@ -0,0 +1,38 @@
+/* (c) 2019-2022 by dbj.org   -- LICENSE DBJ -- https://dbj.org/license_dbj/ */
+/*
+standalone collector for apps running in the DBJ_LOG_SHARED_RING mode
+
+usage: dbj_log_collector <full path of the app exe>
+
+drains the shared memory ring of that app into its one log file
+<full path of the app exe>.log, until Ctrl+C
+while this runs none of the app processes is elected to collect
+*/
+
+// collector itself logs to console only
+#define DBJ_LOG_DEFAULT_SETUP ( DBJ_LOG_MT )
+
+#define DBJ_SIMPLELOG_IMPLEMENTATION
+#include "../dbj_simple_log.h"
+
+static BOOL WINAPI on_ctrl_c_(DWORD ctrl_type_)
+{
+	(void)ctrl_type_;
+	dbj_log_ring_collector_stop();
+	return TRUE;
+}
+
+int main(const int argc, char* argv[])
+{
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s <full path of the app exe>\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	SetConsoleCtrlHandler(on_ctrl_c_, TRUE);
+
+	LOG_INFO("collecting for %s, Ctrl+C to stop", argv[1]);
+	const int rez = dbj_log_ring_collector_run(argv[1]);
+	LOG_INFO("collector done, %s", rez == EXIT_SUCCESS ? "ok" : "failed");
+	return rez;
+}
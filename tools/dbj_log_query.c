@@ -0,0 +1,414 @@
+/* (c) 2019-2022 by dbj.org   -- LICENSE DBJ -- https://dbj.org/license_dbj/ */
+/*
+query the log file written with DBJ_LOG_FILE_INDEX in the setup
+
+usage: dbj_log_query <log file> [options]
+
+	-from <time>    lines not before, "YYYY-MM-DD HH:MM:SS" or "HH:MM:SS" of today
+	-to <time>      lines not after
+	-level <LEVEL>  lines of this level and above: TRACE DEBUG INFO WARN ERROR FATAL
+	-file <text>    lines containing this text, usually the source file name
+	-f              follow, as tail -f does
+	-check          the whole file read back through the index, bad blocks reported
+
+side index, <log file>.idx, is used to seek straight to the blocks in
+the time window, skipping the blocks without the levels required
+without the index the whole file is scanned
+
+file written with DBJ_LOG_CRC, <exe>.log.crc, is read record by record
+the headers are skipped, not checked, that is what dbj_log_recover does
+damaged record stops the query
+*/
+
+#include "../dbj_simple_log.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <share.h>
+
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+static const char* level_names_[] = {
+  "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"
+};
+
+#define level_count_ (sizeof(level_names_) / sizeof(level_names_[0]))
+
+/* lines longer than this are split */
+#define line_max_ (64 * 1024)
+/* longer than that is not the record, it is the garbage */
+#define record_max_ (64 * 1024 * 1024)
+
+typedef struct query_ {
+	/* -1 is not given */
+	long long from;
+	long long to;
+	unsigned level_bits;
+	const char* text;
+	bool follow;
+} query_;
+
+static char line_[line_max_];
+
+/* DBJ_LOG_CRC file, records not lines */
+static bool crc_file_;
+/* text of the record, grows */
+static char* record_;
+static size_t record_cap_;
+
+/* returns -1 on bad input */
+static long long parse_time_(const char* str)
+{
+	struct tm tm_ = { 0 };
+	int y = 0, mo = 0, d = 0, h = 0, mi = 0, se = 0;
+
+	if (6 == sscanf_s(str, "%d-%d-%d %d:%d:%d", &y, &mo, &d, &h, &mi, &se)) {
+		tm_.tm_year = y - 1900;
+		tm_.tm_mon = mo - 1;
+		tm_.tm_mday = d;
+	}
+	else if (3 == sscanf_s(str, "%d:%d:%d", &h, &mi, &se)) {
+		const time_t now_ = time(NULL);
+		if (localtime_s(&tm_, &now_) != 0) return -1;
+	}
+	else {
+		return -1;
+	}
+	tm_.tm_hour = h;
+	tm_.tm_min = mi;
+	tm_.tm_sec = se;
+	tm_.tm_isdst = -1;
+	return (long long)mktime(&tm_);
+}
+
+/*
+file line begins with "HH:MM:SS LEVEL" or "YYYY-MM-DD HH:MM:SS LEVEL"
+with DBJ_LOG_TSC_TIMESTAMP seconds are followed by ".nnnnnnnnn"
+time only stamps take the date of the reference given
+returns the level or -1 if this is not a log line
+*/
+static int line_parse_(const char* line, long long reference, long long* when)
+{
+	const size_t line_len_ = strlen(line);
+	const bool full_ = (line_len_ > 10 && line[4] == '-' && line[7] == '-');
+	const char* level_ = line + (full_ ? 19 : 8);
+
+	if (line_len_ < (size_t)(level_ - line) + 1) return -1;
+	if (*level_ == '.') {
+		if (line_len_ < (size_t)(level_ - line) + 11) return -1;
+		level_ += 10;
+	}
+	level_ += 1;
+
+	if (line_len_ < (size_t)(level_ - line) + 4) return -1;
+
+	if (full_) {
+		char stamp_[20] = { 0 };
+		memcpy(stamp_, line, 19);
+		*when = parse_time_(stamp_);
+	}
+	else {
+		int h = 0, mi = 0, se = 0;
+		struct tm tm_ = { 0 };
+		const time_t ref_ = (time_t)reference;
+		if (3 != sscanf_s(line, "%d:%d:%d", &h, &mi, &se) || localtime_s(&tm_, &ref_) != 0) return -1;
+		tm_.tm_hour = h;
+		tm_.tm_min = mi;
+		tm_.tm_sec = se;
+		tm_.tm_isdst = -1;
+		*when = (long long)mktime(&tm_);
+	}
+
+	for (int lvl = 0; lvl < (int)level_count_; ++lvl) {
+		const size_t len = strlen(level_names_[lvl]);
+		if (0 == strncmp(level_, level_names_[lvl], len) && (level_[len] == ' ' || level_[len] == ':'))
+			return lvl;
+	}
+	return -1;
+}
+
+static bool line_wanted_(const char* line, long long reference, const query_* q)
+{
+	long long when = -1;
+	const int lvl = line_parse_(line, reference, &when);
+
+	/* banners and such are shown if nothing else is asked for */
+	if (lvl < 0) return q->from < 0 && q->to < 0 && q->text == NULL;
+
+	if (0 == (q->level_bits & (1u << lvl))) return false;
+	if (q->from >= 0 && when < q->from) return false;
+	if (q->to >= 0 && when > q->to) return false;
+	if (q->text && !strstr(line, q->text)) return false;
+	return true;
+}
+
+/* the wanted lines of the record text, each one is copied to be parsed */
+static void record_lines_(const char* text, size_t len, long long reference, const query_* q)
+{
+	while (len > 0)
+	{
+		const char* eol_ = (const char*)memchr(text, '\n', len);
+		const size_t line_len_ = eol_ ? (size_t)(eol_ - text) + 1 : len;
+		const size_t copy_ = line_len_ < line_max_ ? line_len_ : line_max_ - 1;
+
+		memcpy(line_, text, copy_);
+		line_[copy_] = '\0';
+		if (line_wanted_(line_, reference, q))
+			fputs(line_, stdout);
+
+		/* split, as fgets does */
+		text += copy_;
+		len -= copy_;
+	}
+}
+
+/*
+DBJ_LOG_CRC file, as scan_ below
+partial record at the EOF is left for the next time
+returns -1 on the damaged record
+*/
+static long long scan_records_(FILE* fp, long long from, long long to, long long reference, const query_* q)
+{
+	long long pos = from;
+	dbj_log_crc_header header_;
+	while (to < 0 || pos < to)
+	{
+		if (1 != fread(&header_, sizeof(header_), 1, fp)) break;
+		if (header_.magic != DBJ_LOG_CRC_MAGIC || header_.length > record_max_) {
+			fprintf(stderr, "damaged record at %lld, use dbj_log_recover\n", pos);
+			return -1;
+		}
+
+		if (header_.length > record_cap_) {
+			char* bigger_ = (char*)realloc(record_, header_.length);
+			if (!bigger_) break;
+			record_ = bigger_;
+			record_cap_ = header_.length;
+		}
+		/* still being written */
+		if (header_.length != fread(record_, 1, header_.length, fp)) break;
+		pos += (long long)(sizeof(header_) + header_.length);
+
+		record_lines_(record_, header_.length, reference, q);
+	}
+	return pos;
+}
+
+/*
+print the wanted lines from the position given up to the end given, -1 is EOF
+partial line at the EOF is left for the next time
+returns the position reached
+*/
+static long long scan_(FILE* fp, long long from, long long to, long long reference, const query_* q)
+{
+	clearerr(fp);
+	if (_fseeki64(fp, from, SEEK_SET) != 0) return from;
+	if (crc_file_) return scan_records_(fp, from, to, reference, q);
+
+	long long pos = from;
+	while (to < 0 || pos < to)
+	{
+		if (!fgets(line_, sizeof(line_), fp)) break;
+
+		const size_t len = strlen(line_);
+		if (line_[len - 1] != '\n' && feof(fp)) {
+			/* still being written */
+			break;
+		}
+		pos += (long long)len;
+
+		if (line_wanted_(line_, reference, q))
+			fputs(line_, stdout);
+	}
+	return pos;
+}
+
+/*
+one index block read back: it starts just after the line before,
+ends at the end of the line, holds as many lines as the index says
+in DBJ_LOG_CRC file it is the whole records
+*/
+static bool block_good_(FILE* fp, const dbj_log_index_entry* e)
+{
+	if (e->offset > 0) {
+		if (_fseeki64(fp, (long long)e->offset - 1, SEEK_SET) || fgetc(fp) != '\n') return false;
+	}
+	else if (_fseeki64(fp, 0, SEEK_SET)) return false;
+
+	if (e->bytes > record_max_) return false;
+	if (e->bytes > record_cap_) {
+		char* bigger_ = (char*)realloc(record_, (size_t)e->bytes);
+		if (!bigger_) return false;
+		record_ = bigger_;
+		record_cap_ = (size_t)e->bytes;
+	}
+	if (e->bytes != fread(record_, 1, (size_t)e->bytes, fp)) return false;
+
+	unsigned long long lines_ = 0;
+	for (size_t at_ = 0; at_ < e->bytes; )
+	{
+		size_t len_ = (size_t)e->bytes - at_;
+		if (crc_file_) {
+			dbj_log_crc_header header_;
+			if (len_ <= sizeof(header_)) return false;
+			memcpy(&header_, record_ + at_, sizeof(header_));
+			at_ += sizeof(header_);
+			if (header_.magic != DBJ_LOG_CRC_MAGIC || header_.length > len_ - sizeof(header_)) return false;
+			len_ = header_.length;
+		}
+		const char* text_ = record_ + at_;
+		for (size_t j = 0; j < len_; ++j) lines_ += text_[j] == '\n';
+		if (len_ == 0 || text_[len_ - 1] != '\n') return false;
+		at_ += len_;
+	}
+	return lines_ == e->lines;
+}
+
+/* all the blocks of the index, returns the number of the bad ones */
+static size_t index_check_(FILE* fp, const char* name, const dbj_log_index_entry* entries, size_t count)
+{
+	size_t bad_ = 0;
+	for (size_t j = 0; j < count; ++j) {
+		if (block_good_(fp, entries + j)) continue;
+		fprintf(stderr, "%s: block %zu at %llu, %llu bytes, is bad\n", name, j, entries[j].offset, entries[j].bytes);
+		bad_ += 1;
+	}
+	fprintf(stderr, "%s: %zu index blocks, %zu bad\n", name, count, bad_);
+	return bad_;
+}
+
+/* NULL if no index, caller frees */
+static dbj_log_index_entry* index_load_(const char* log_name, size_t* count)
+{
+	char name_[1024];
+	*count = 0;
+	if (_snprintf_s(name_, sizeof(name_), _TRUNCATE, "%s.idx", log_name) < 0) return NULL;
+
+	FILE* fp = _fsopen(name_, "rb", _SH_DENYNO);
+	if (!fp) return NULL;
+
+	dbj_log_index_header header_ = { 0 };
+	if (1 != fread(&header_, sizeof(header_), 1, fp)
+		|| header_.magic != DBJ_LOG_INDEX_MAGIC
+		|| header_.entry_size != sizeof(dbj_log_index_entry)) {
+		fclose(fp);
+		return NULL;
+	}
+
+	_fseeki64(fp, 0, SEEK_END);
+	const long long size_ = _ftelli64(fp) - (long long)sizeof(header_);
+	const size_t n = (size_t)(size_ / (long long)sizeof(dbj_log_index_entry));
+	_fseeki64(fp, sizeof(header_), SEEK_SET);
+
+	dbj_log_index_entry* entries = (dbj_log_index_entry*)calloc(n ? n : 1, sizeof(dbj_log_index_entry));
+	if (entries) *count = fread(entries, sizeof(dbj_log_index_entry), n, fp);
+	fclose(fp);
+	return entries;
+}
+
+static int usage_(const char* self)
+{
+	fprintf(stderr, "usage: %s <log file> [-from <time>] [-to <time>] [-level <LEVEL>] [-file <text>] [-f] [-check]\n", self);
+	fprintf(stderr, "time is \"YYYY-MM-DD HH:MM:SS\" or \"HH:MM:SS\" of today\n");
+	return EXIT_FAILURE;
+}
+
+int main(const int argc, char* argv[])
+{
+	if (argc < 2) return usage_(argv[0]);
+
+	query_ q = { -1, -1, (1u << level_count_) - 1, NULL, false };
+	bool check_ = false;
+
+	for (int j = 2; j < argc; ++j) {
+		const bool has_value = j + 1 < argc;
+		if (0 == strcmp(argv[j], "-f")) {
+			q.follow = true;
+		}
+		else if (0 == strcmp(argv[j], "-check")) {
+			check_ = true;
+		}
+		else if (0 == strcmp(argv[j], "-from") && has_value) {
+			if ((q.from = parse_time_(argv[++j])) < 0) return usage_(argv[0]);
+		}
+		else if (0 == strcmp(argv[j], "-to") && has_value) {
+			if ((q.to = parse_time_(argv[++j])) < 0) return usage_(argv[0]);
+		}
+		else if (0 == strcmp(argv[j], "-file") && has_value) {
+			q.text = argv[++j];
+		}
+		else if (0 == strcmp(argv[j], "-level") && has_value) {
+			const char* wanted_ = argv[++j];
+			int lvl = 0;
+			while (lvl < (int)level_count_ && 0 != _stricmp(wanted_, level_names_[lvl])) ++lvl;
+			if (lvl == (int)level_count_) return usage_(argv[0]);
+			q.level_bits = ((1u << level_count_) - 1) & ~((1u << lvl) - 1);
+		}
+		else {
+			return usage_(argv[0]);
+		}
+	}
+
+	FILE* log_ = _fsopen(argv[1], "rb", _SH_DENYNO);
+	if (!log_) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+
+	/* by the name, or the first record, the file may be empty yet */
+	{
+		const size_t name_len_ = strlen(argv[1]);
+		unsigned magic_ = 0;
+		crc_file_ = (name_len_ > 4 && 0 == _stricmp(argv[1] + name_len_ - 4, ".crc"))
+			|| (1 == fread(&magic_, sizeof(magic_), 1, log_) && magic_ == DBJ_LOG_CRC_MAGIC);
+	}
+
+	size_t count = 0;
+	dbj_log_index_entry* entries = index_load_(argv[1], &count);
+
+	if (check_) {
+		if (!entries) fprintf(stderr, "%s: no index\n", argv[1]);
+		const size_t bad_ = entries ? index_check_(log_, argv[1], entries, count) : 1;
+		free(entries);
+		free(record_);
+		fclose(log_);
+		return bad_ ? EXIT_FAILURE : EXIT_SUCCESS;
+	}
+
+	long long pos = 0;
+	bool past_window = false;
+
+	for (size_t j = 0; j < count; ++j)
+	{
+		const dbj_log_index_entry* e = entries + j;
+		pos = (long long)(e->offset + e->bytes);
+
+		if (q.from >= 0 && e->last_time < q.from) continue;
+		if (q.to >= 0 && e->first_time > q.to) {
+			past_window = true;
+			break;
+		}
+		if (0 == (e->level_bits & q.level_bits)) continue;
+
+		(void)scan_(log_, (long long)e->offset, (long long)(e->offset + e->bytes), e->first_time, &q);
+	}
+	free(entries);
+
+	/* the rest is not indexed yet */
+	if (!past_window)
+		pos = scan_(log_, pos, -1, (long long)time(NULL), &q);
+
+	while (q.follow && pos >= 0) {
+		fflush(stdout);
+		Sleep(250);
+		pos = scan_(log_, pos, -1, (long long)time(NULL), &q);
+	}
+
+	free(record_);
+	fclose(log_);
+	return pos < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
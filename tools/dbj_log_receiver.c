@@ -0,0 +1,160 @@
+/* (c) 2019-2022 by dbj.org   -- LICENSE DBJ -- https://dbj.org/license_dbj/ */
+/*
+stand-in for the log collector of the apps running with DBJ_LOG_NET
+
+usage: dbj_log_receiver <port> <output file> [-udp]
+
+frames received are appended to the output file, as they are
+read it with dbj_log_cat, there is no seek table, frames are walked
+TCP: one sender at a time, partial frame at the disconnect is dropped
+UDP: one frame per datagram, anything else is dropped
+until Ctrl+C
+*/
+
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#include "../dbj_simple_log.h"
+
+#include <stdbool.h>
+#include <string.h>
+#include <share.h>
+
+#pragma comment(lib, "ws2_32.lib")
+
+/* largest frame taken, raw text is never more than DBJ_LOG_NET_BATCH of the sender */
+#define frame_max_ (1024 * 1024)
+
+static unsigned char frame_[frame_max_];
+static unsigned long long frames_ = 0, dropped_ = 0;
+
+static bool header_ok_(const dbj_log_frame_header* header)
+{
+	return header->magic == DBJ_LOG_FRAME_MAGIC
+		&& header->stored_size <= frame_max_ - sizeof(*header)
+		&& header->raw_size > 0;
+}
+
+static void frame_keep_(FILE* out, size_t len)
+{
+	fwrite(frame_, 1, len, out);
+	fflush(out);
+	frames_ += 1;
+}
+
+/* false on disconnect */
+static bool recv_all_(SOCKET sock, unsigned char* dst, size_t len)
+{
+	while (len) {
+		const int got_ = recv(sock, (char*)dst, (int)len, 0);
+		if (got_ <= 0) return false;
+		dst += got_;
+		len -= (size_t)got_;
+	}
+	return true;
+}
+
+static void receive_tcp_(SOCKET listener, FILE* out)
+{
+	for (;;)
+	{
+		SOCKET sender_ = accept(listener, NULL, NULL);
+		if (sender_ == INVALID_SOCKET) return;
+
+		dbj_log_frame_header header_;
+		while (recv_all_(sender_, frame_, sizeof(header_)))
+		{
+			memcpy(&header_, frame_, sizeof(header_));
+			if (!header_ok_(&header_)) {
+				/* not our sender, or lost the framing */
+				dropped_ += 1;
+				break;
+			}
+			if (!recv_all_(sender_, frame_ + sizeof(header_), header_.stored_size)) {
+				dropped_ += 1;
+				break;
+			}
+			frame_keep_(out, sizeof(header_) + header_.stored_size);
+		}
+
+		closesocket(sender_);
+		fprintf(stderr, "sender gone, %llu frames kept, %llu dropped so far\n", frames_, dropped_);
+	}
+}
+
+static void receive_udp_(SOCKET sock, FILE* out)
+{
+	for (;;)
+	{
+		const int got_ = recvfrom(sock, (char*)frame_, (int)sizeof(frame_), 0, NULL, NULL);
+		if (got_ == SOCKET_ERROR) return;
+
+		dbj_log_frame_header header_ = { 0 };
+		if ((size_t)got_ >= sizeof(header_)) memcpy(&header_, frame_, sizeof(header_));
+		if ((size_t)got_ < sizeof(header_) || !header_ok_(&header_)
+			|| header_.stored_size != (size_t)got_ - sizeof(header_)) {
+			dropped_ += 1;
+			continue;
+		}
+		frame_keep_(out, (size_t)got_);
+	}
+}
+
+int main(const int argc, char* argv[])
+{
+	if (argc < 3 || (argc > 3 && 0 != strcmp(argv[3], "-udp"))) {
+		fprintf(stderr, "usage: %s <port> <output file> [-udp]\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+	const bool udp_ = argc > 3;
+
+	WSADATA wsa_;
+	if (0 != WSAStartup(MAKEWORD(2, 2), &wsa_)) {
+		fprintf(stderr, "%s: no winsock\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	FILE* out = _fsopen(argv[2], "ab", _SH_DENYWR);
+	if (!out) {
+		perror(argv[2]);
+		WSACleanup();
+		return EXIT_FAILURE;
+	}
+
+	struct addrinfo hints_ = { 0 };
+	hints_.ai_family = AF_INET;
+	hints_.ai_socktype = udp_ ? SOCK_DGRAM : SOCK_STREAM;
+	hints_.ai_protocol = udp_ ? IPPROTO_UDP : IPPROTO_TCP;
+	hints_.ai_flags = AI_PASSIVE;
+
+	struct addrinfo* local_ = NULL;
+	SOCKET sock_ = INVALID_SOCKET;
+	if (0 == getaddrinfo(NULL, argv[1], &hints_, &local_)) {
+		sock_ = socket(local_->ai_family, local_->ai_socktype, local_->ai_protocol);
+		if (sock_ != INVALID_SOCKET
+			&& (SOCKET_ERROR == bind(sock_, local_->ai_addr, (int)local_->ai_addrlen)
+				|| (!udp_ && SOCKET_ERROR == listen(sock_, SOMAXCONN)))) {
+			closesocket(sock_);
+			sock_ = INVALID_SOCKET;
+		}
+		freeaddrinfo(local_);
+	}
+
+	if (sock_ == INVALID_SOCKET) {
+		fprintf(stderr, "%s: can not listen on %s, error %d\n", argv[0], argv[1], WSAGetLastError());
+		fclose(out);
+		WSACleanup();
+		return EXIT_FAILURE;
+	}
+
+	fprintf(stderr, "receiving on %s %s into %s, Ctrl+C to stop\n", udp_ ? "UDP" : "TCP", argv[1], argv[2]);
+
+	if (udp_)
+		receive_udp_(sock_, out);
+	else
+		receive_tcp_(sock_, out);
+
+	closesocket(sock_);
+	fclose(out);
+	WSACleanup();
+	return EXIT_SUCCESS;
+}
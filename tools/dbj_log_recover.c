@@ -0,0 +1,196 @@
+/* (c) 2019-2022 by dbj.org   -- LICENSE DBJ -- https://dbj.org/license_dbj/ */
+/*
+check the log file written with DBJ_LOG_CRC in the setup, after the crash
+
+usage: dbj_log_recover <log file> [options]
+
+	-truncate       damaged tail is cut off, file ends with the last good record
+	-force          truncate even if there are good records after the damage
+	-print          text of the good records to stdout
+
+records are checked from the start, up to the first bad one
+the rest of the file is then searched for the good records
+after the crash or the power loss there are none, that is the torn tail
+file is read in big chunks and checked in memory, as fast as the disk goes
+*/
+
+// tool logs nothing, no startup needed
+#define DBJ_LOG_DEFAULT_SETUP ( DBJ_LOG_LAZY )
+
+#define DBJ_SIMPLELOG_IMPLEMENTATION
+#include "../dbj_simple_log.h"
+
+#include <share.h>
+
+/* file is read that much at once */
+#define chunk_ (4 * 1024 * 1024)
+/* longer than that is not the record, it is the garbage */
+#define record_max_ (64 * 1024 * 1024)
+
+typedef struct scan_ {
+	FILE* fp;
+	unsigned char* buf;
+	size_t cap;
+	/* not yet checked part of the buf */
+	size_t begin, end;
+	/* in the file, of the buf[begin] */
+	unsigned long long offset;
+	bool eof;
+} scan_;
+
+/* at least n bytes from the begin, false if the file is shorter */
+static bool scan_need_(scan_* s, size_t n)
+{
+	if (s->end - s->begin >= n) return true;
+	if (s->eof) return false;
+
+	memmove(s->buf, s->buf + s->begin, s->end - s->begin);
+	s->end -= s->begin;
+	s->begin = 0;
+
+	if (n > s->cap) {
+		unsigned char* bigger_ = (unsigned char*)realloc(s->buf, n);
+		if (!bigger_) return false;
+		s->buf = bigger_;
+		s->cap = n;
+	}
+
+	while (!s->eof && s->end < n) {
+		const size_t got_ = fread(s->buf + s->end, 1, s->cap - s->end, s->fp);
+		if (got_ == 0) s->eof = true;
+		s->end += got_;
+	}
+	return s->end >= n;
+}
+
+static void scan_skip_(scan_* s, size_t n)
+{
+	s->begin += n;
+	s->offset += n;
+}
+
+/* the whole record is in the buf, at the begin */
+static bool record_good_(scan_* s, dbj_log_crc_header* header)
+{
+	if (!scan_need_(s, sizeof(*header))) return false;
+	memcpy(header, s->buf + s->begin, sizeof(*header));
+	if (header->magic != DBJ_LOG_CRC_MAGIC || header->length > record_max_) return false;
+	if (!scan_need_(s, sizeof(*header) + header->length)) return false;
+
+	const unsigned crc_ = dbj_log_crc32c(dbj_log_crc32c(0, &header->length, sizeof(header->length)),
+		s->buf + s->begin + sizeof(*header), header->length);
+	return crc_ == header->crc;
+}
+
+/* the next good record after the damage, its offset */
+static bool record_find_(scan_* s, unsigned long long* at)
+{
+	/* first byte of the magic, little endian */
+	const unsigned char first_ = (unsigned char)(DBJ_LOG_CRC_MAGIC & 0xFF);
+	dbj_log_crc_header header_;
+
+	scan_skip_(s, 1);
+	while (scan_need_(s, sizeof(header_)))
+	{
+		const unsigned char* from_ = s->buf + s->begin;
+		const unsigned char* hit_ = (const unsigned char*)memchr(from_, first_, s->end - s->begin);
+		if (!hit_) {
+			scan_skip_(s, s->end - s->begin);
+			continue;
+		}
+		scan_skip_(s, (size_t)(hit_ - from_));
+
+		if (record_good_(s, &header_)) {
+			*at = s->offset;
+			return true;
+		}
+		scan_skip_(s, 1);
+	}
+	return false;
+}
+
+static int usage_(const char* self)
+{
+	fprintf(stderr, "usage: %s <log file> [-truncate] [-force] [-print]\n", self);
+	return EXIT_FAILURE;
+}
+
+int main(const int argc, char* argv[])
+{
+	if (argc < 2) return usage_(argv[0]);
+
+	bool truncate_ = false, force_ = false, print_ = false;
+	for (int j = 2; j < argc; ++j) {
+		if (0 == strcmp(argv[j], "-truncate"))
+			truncate_ = true;
+		else if (0 == strcmp(argv[j], "-force"))
+			force_ = true;
+		else if (0 == strcmp(argv[j], "-print"))
+			print_ = true;
+		else
+			return usage_(argv[0]);
+	}
+
+	scan_ scan = { 0 };
+	scan.fp = _fsopen(argv[1], truncate_ ? "r+b" : "rb", truncate_ ? _SH_DENYRW : _SH_DENYNO);
+	if (!scan.fp) {
+		perror(argv[1]);
+		return EXIT_FAILURE;
+	}
+	scan.cap = chunk_;
+	scan.buf = (unsigned char*)malloc(scan.cap);
+	if (!scan.buf) {
+		perror(argv[0]);
+		fclose(scan.fp);
+		return EXIT_FAILURE;
+	}
+
+	_fseeki64(scan.fp, 0, SEEK_END);
+	const unsigned long long size_ = (unsigned long long)_ftelli64(scan.fp);
+	_fseeki64(scan.fp, 0, SEEK_SET);
+
+	unsigned long long records_ = 0;
+	dbj_log_crc_header header_;
+	while (record_good_(&scan, &header_))
+	{
+		if (print_)
+			fwrite(scan.buf + scan.begin + sizeof(header_), 1, header_.length, stdout);
+		scan_skip_(&scan, sizeof(header_) + header_.length);
+		records_ += 1;
+	}
+
+	const unsigned long long good_end_ = scan.offset;
+	int rez_ = EXIT_SUCCESS;
+
+	if (good_end_ == size_) {
+		fprintf(stderr, "%s: %llu records, %llu bytes, all good\n", argv[1], records_, size_);
+	}
+	else {
+		fprintf(stderr, "%s: %llu records, %llu bytes good, damaged from %llu, %llu bytes\n",
+			argv[1], records_, good_end_, good_end_, size_ - good_end_);
+
+		unsigned long long later_ = 0;
+		const bool mid_file_ = record_find_(&scan, &later_);
+		if (mid_file_)
+			fprintf(stderr, "%s: there are good records after the damage, the first at %llu\n", argv[1], later_);
+
+		if (truncate_ && (!mid_file_ || force_)) {
+			fflush(scan.fp);
+			if (0 == _chsize_s(_fileno(scan.fp), (long long)good_end_))
+				fprintf(stderr, "%s: truncated to %llu bytes\n", argv[1], good_end_);
+			else {
+				perror(argv[1]);
+				rez_ = EXIT_FAILURE;
+			}
+		}
+		else {
+			if (truncate_)
+				fprintf(stderr, "%s: not truncated, use -force to lose the good records after the damage\n", argv[1]);
+			rez_ = EXIT_FAILURE;
+		}
+	}
+
+	free(scan.buf);
+	fclose(scan.fp);
+	return rez_;
+}